@@ -14,12 +14,25 @@
 #include "interpreter/interp_incl.h"
 #include "ir/BC.h"
 #include "ir/Compiler.h"
+#include "runtime/CodeCache.h"
+#include "runtime/RuntimeStats.h"
+#include "utils/Pool.h"
+#include "utils/json.h"
+#include "utils/tracing.h"
 
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
+#include <fstream>
+#include <functional>
 #include <list>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <unistd.h>
 
 using namespace rir;
 
@@ -284,6 +297,55 @@ REXPORT SEXP pirSetDebugFlags(SEXP debugFlags) {
     return R_NilValue;
 }
 
+// Directory to write the input of every compilation to, see
+// rirReplayCompile. Empty if compilations are not dumped.
+static std::string compileDumpDir =
+    getenv("PIR_COMPILE_DUMP") ? getenv("PIR_COMPILE_DUMP") : "";
+
+static void dumpCompile(SEXP what, const Context& assumptions,
+                        const std::string& name) {
+    static unsigned dumps = 0;
+    std::stringstream path;
+    path << compileDumpDir << "/compile-" << getpid() << "-" << dumps++
+         << ".dump";
+    FILE* file = fopen(path.str().c_str(), "w");
+    if (!file) {
+        std::cerr << "ERROR: Can't open compile dump '" << path.str() << "'\n";
+        return;
+    }
+
+    SEXP context = PROTECT(Rf_allocVector(RAWSXP, sizeof(Context)));
+    memcpy(RAW(context), &assumptions, sizeof(Context));
+    SEXP dump = PROTECT(Rf_allocVector(VECSXP, 3));
+    SET_VECTOR_ELT(dump, 0, what);
+    SET_VECTOR_ELT(dump, 1, context);
+    SET_VECTOR_ELT(dump, 2, Rf_mkString(name.c_str()));
+
+    // The baseline versions carry the feedback, they are only serialized
+    // with RIR_PRESERVE. The flag is restored and the file closed even if
+    // the save errors out.
+    struct Save {
+        SEXP dump;
+        FILE* file;
+        bool preserve;
+    } save = {dump, file, pir::Parameter::RIR_PRESERVE};
+    pir::Parameter::RIR_PRESERVE = true;
+    R_ExecWithCleanup(
+        [](void* data) {
+            auto save = (Save*)data;
+            R_SaveToFile(save->dump, save->file, 0);
+            return R_NilValue;
+        },
+        &save,
+        [](void* data) {
+            auto save = (Save*)data;
+            pir::Parameter::RIR_PRESERVE = save->preserve;
+            fclose(save->file);
+        },
+        &save);
+    UNPROTECT(2);
+}
+
 SEXP pirCompile(SEXP what, const Context& assumptions, const std::string& name,
                 const pir::DebugOptions& debug) {
     if (!isValidClosureSEXP(what)) {
@@ -295,34 +357,60 @@ SEXP pirCompile(SEXP what, const Context& assumptions, const std::string& name,
 
     PROTECT(what);
 
+    if (!compileDumpDir.empty())
+        dumpCompile(what, assumptions, name);
+
     bool dryRun = debug.includes(pir::DebugFlag::DryRun);
+    auto start = std::chrono::steady_clock::now();
+    Function* installed = nullptr;
+    Protect protectInstalled;
     // compile to pir
     pir::Module* m = new pir::Module;
-    pir::StreamLogger logger(debug);
-    logger.title("Compiling " + name);
-    pir::Compiler cmp(m, logger);
-    pir::Backend backend(logger, name);
-    cmp.compileClosure(what, name, assumptions, true,
-                       [&](pir::ClosureVersion* c) {
-                           logger.flush();
-                           cmp.optimizeModule();
-
-                           auto fun = backend.getOrCompile(c);
-
-                           // Install
-                           if (dryRun)
-                               return;
-
-                           Protect p(fun->container());
-                           DispatchTable::unpack(BODY(what))->insert(fun);
-                       },
-                       [&]() {
-                           if (debug.includes(pir::DebugFlag::ShowWarnings))
-                               std::cerr << "Compilation failed\n";
-                       },
-                       {});
-
+    {
+        pir::StreamLogger logger(debug);
+        logger.title("Compiling " + name);
+        pir::Compiler cmp(m, logger);
+        // The native code is only finalized when the backend is destroyed
+        pir::Backend backend(logger, name);
+        cmp.compileClosure(
+            what, name, assumptions, true,
+            [&](pir::ClosureVersion* c) {
+                logger.flush();
+                cmp.optimizeModule();
+
+                auto fun = backend.getOrCompile(c);
+
+                // Install
+                if (dryRun)
+                    return;
+
+                protectInstalled(fun->container());
+                DispatchTable::unpack(BODY(what))->insert(fun);
+                installed = fun;
+            },
+            [&]() {
+                RuntimeStats::failedCompilations++;
+                if (debug.includes(pir::DebugFlag::ShowWarnings))
+                    std::cerr << "Compilation failed\n";
+            },
+            {});
+    }
     delete m;
+
+    // Only count the compilations that produced a version, dry runs and
+    // failures would skew the time per compilation
+    if (installed) {
+        std::chrono::duration<double> time =
+            std::chrono::steady_clock::now() - start;
+        auto table = DispatchTable::unpack(BODY(what));
+        table->registerCompilation(time.count());
+        RuntimeStats::compilations++;
+        RuntimeStats::compileTime += time.count();
+
+        // The native code size is only known now
+        CodeCache::install(table, installed);
+    }
+
     UNPROTECT(1);
     return what;
 }
@@ -341,6 +429,274 @@ REXPORT SEXP rirInvocationCount(SEXP what) {
     return res;
 }
 
+REXPORT SEXP rirFeedback(SEXP what) {
+    if (!isValidClosureSEXP(what)) {
+        Rf_error("not a compiled closure");
+    }
+    auto baseline = DispatchTable::unpack(BODY(what))->baseline();
+
+    std::vector<std::string> entries;
+    std::function<void(Code*, const std::string&)> collect =
+        [&](Code* code, const std::string& prefix) {
+            std::vector<BC::FunIdx> promises;
+            for (auto pc = code->code(); pc < code->endCode();
+                 pc = BC::next(pc)) {
+                auto bc = BC::decode(pc, code);
+                bc.addMyPromArgsTo(promises);
+                if (bc.bc != Opcode::record_call_ &&
+                    bc.bc != Opcode::record_type_ &&
+                    bc.bc != Opcode::record_test_)
+                    continue;
+                std::stringstream line;
+                line << prefix << (pc - code->code()) << ":";
+                bc.print(line);
+                auto str = line.str();
+                str.erase(str.find_last_not_of(" \n") + 1);
+                entries.push_back(str);
+            }
+            for (auto i : promises)
+                if (code->isPromiseCompiled(i))
+                    collect(code->getPromise(i),
+                            prefix + "promise " + std::to_string(i) + " @ ");
+        };
+    collect(baseline->body(), "");
+
+    SEXP res = PROTECT(Rf_allocVector(STRSXP, entries.size()));
+    for (size_t i = 0; i < entries.size(); ++i)
+        SET_STRING_ELT(res, i, Rf_mkChar(entries[i].c_str()));
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rirResetFeedback(SEXP what) {
+    if (!isValidClosureSEXP(what)) {
+        Rf_error("not a compiled closure");
+    }
+    DispatchTable::unpack(BODY(what))->baseline()->resetFeedback();
+    return R_NilValue;
+}
+
+static void checkClosureList(SEXP what) {
+    if (TYPEOF(what) != VECSXP)
+        Rf_error("expected a list of closures");
+    for (R_xlen_t i = 0; i < XLENGTH(what); ++i)
+        if (!isValidClosureSEXP(VECTOR_ELT(what, i)))
+            Rf_error("not a compiled closure");
+}
+
+REXPORT SEXP rirStats(SEXP what) {
+    checkClosureList(what);
+    auto n = XLENGTH(what);
+
+    static const char* columns[] = {"invocations",    "versions",
+                                    "nativeCodeSize", "deopts",
+                                    "compilations",   "compileTime",
+                                    "feedbackSplits"};
+    constexpr size_t ncol = sizeof(columns) / sizeof(columns[0]);
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, ncol));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, ncol));
+    for (size_t c = 0; c < ncol; ++c) {
+        SET_VECTOR_ELT(res, c, Rf_allocVector(REALSXP, n));
+        SET_STRING_ELT(names, c, Rf_mkChar(columns[c]));
+    }
+    Rf_setAttrib(res, R_NamesSymbol, names);
+
+    for (R_xlen_t i = 0; i < n; ++i) {
+        auto dt = DispatchTable::unpack(BODY(VECTOR_ELT(what, i)));
+        double invocations = 0, size = 0;
+        for (size_t j = 0; j < dt->size(); ++j) {
+            invocations += dt->get(j)->invocationCount();
+            size += dt->get(j)->body()->totalNativeCodeSize();
+        }
+        REAL(VECTOR_ELT(res, 0))[i] = invocations;
+        REAL(VECTOR_ELT(res, 1))[i] = dt->size();
+        REAL(VECTOR_ELT(res, 2))[i] = size;
+        REAL(VECTOR_ELT(res, 3))[i] = dt->deopts();
+        REAL(VECTOR_ELT(res, 4))[i] = dt->compilations();
+        REAL(VECTOR_ELT(res, 5))[i] = dt->compileTime();
+        REAL(VECTOR_ELT(res, 6))[i] = dt->baseline()->numFeedbackSplits();
+    }
+
+    UNPROTECT(2);
+    return res;
+}
+
+REXPORT SEXP rirRuntimeStats(SEXP reset) {
+    std::vector<std::pair<std::string, double>> stats;
+    stats.emplace_back("compilations", RuntimeStats::compilations);
+    stats.emplace_back("compileTime", RuntimeStats::compileTime);
+    stats.emplace_back("failedCompilations", RuntimeStats::failedCompilations);
+    for (size_t r = DeoptReason::Typecheck; r < RuntimeStats::NumDeoptReasons;
+         ++r)
+        stats.emplace_back(std::string("deopts.") +
+                               RuntimeStats::deoptReasonNames[r],
+                           RuntimeStats::deopts[r]);
+    double hits = RuntimeStats::bindingCacheHits;
+    double misses = RuntimeStats::bindingCacheMisses;
+    stats.emplace_back("bindingCacheHits", hits);
+    stats.emplace_back("bindingCacheMisses", misses);
+    stats.emplace_back("bindingCacheHitRate",
+                       hits + misses > 0 ? hits / (hits + misses) : NA_REAL);
+    stats.emplace_back("globalBindingCacheHits",
+                       RuntimeStats::globalBindingCacheHits);
+    stats.emplace_back("globalBindingCacheMisses",
+                       RuntimeStats::globalBindingCacheMisses);
+    stats.emplace_back("globalBindingCacheUncacheable",
+                       RuntimeStats::globalBindingCacheUncacheable);
+    stats.emplace_back("promisesRecycled", RuntimeStats::promisesRecycled);
+    stats.emplace_back("loopVarsUpdatedInPlace",
+                       RuntimeStats::loopVarsUpdatedInPlace);
+    stats.emplace_back("codeCacheEvictions", RuntimeStats::codeCacheEvictions);
+    stats.emplace_back("codeCacheRecompiles",
+                       RuntimeStats::codeCacheRecompiles);
+    stats.emplace_back("nativeModulesReleased",
+                       RuntimeStats::nativeModulesReleased);
+
+    if (Rf_asLogical(reset) == TRUE)
+        RuntimeStats::reset();
+
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, 2));
+    SEXP counters = Rf_allocVector(STRSXP, stats.size());
+    SET_VECTOR_ELT(res, 0, counters);
+    SEXP values = Rf_allocVector(REALSXP, stats.size());
+    SET_VECTOR_ELT(res, 1, values);
+    for (size_t i = 0; i < stats.size(); ++i) {
+        SET_STRING_ELT(counters, i, Rf_mkChar(stats[i].first.c_str()));
+        REAL(values)[i] = stats[i].second;
+    }
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(names, 0, Rf_mkChar("counter"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("value"));
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return res;
+}
+
+static const char* closureMemoryColumns[] = {
+    "dispatchTable", "functions", "code", "typeFeedback", "nativeCode",
+    "total"};
+
+static std::array<size_t, 6> closureMemoryRow(SEXP closure) {
+    ClosureMemory m(DispatchTable::unpack(BODY(closure)));
+    return {m.dispatchTable, m.functions, m.code,
+            m.typeFeedback,  m.nativeCode, m.total()};
+}
+
+static std::vector<std::pair<std::string, size_t>> memoryTotals() {
+    return {{"constantPool", Pool::memoryUsage()},
+            {"llvmCode", RuntimeStats::llvmCodeBytes},
+            {"llvmData", RuntimeStats::llvmDataBytes},
+            {"llvmHighWater", RuntimeStats::llvmHighWater},
+            {"codeCache", CodeCache::size()},
+            {"deoptMetadata", RuntimeStats::deoptMetadataBytes},
+            {"deoptMetadataUncompressed",
+             RuntimeStats::deoptMetadataUncompressedBytes}};
+}
+
+REXPORT SEXP rirMemory(SEXP what) {
+    checkClosureList(what);
+    auto n = XLENGTH(what);
+    constexpr size_t ncol =
+        sizeof(closureMemoryColumns) / sizeof(closureMemoryColumns[0]);
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, ncol));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, ncol));
+    for (size_t c = 0; c < ncol; ++c) {
+        SET_VECTOR_ELT(res, c, Rf_allocVector(REALSXP, n));
+        SET_STRING_ELT(names, c, Rf_mkChar(closureMemoryColumns[c]));
+    }
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    for (R_xlen_t i = 0; i < n; ++i) {
+        auto row = closureMemoryRow(VECTOR_ELT(what, i));
+        for (size_t c = 0; c < ncol; ++c)
+            REAL(VECTOR_ELT(res, c))[i] = row[c];
+    }
+    UNPROTECT(2);
+    return res;
+}
+
+REXPORT SEXP rirMemoryTotals() {
+    auto totals = memoryTotals();
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, 2));
+    SEXP subsystems = Rf_allocVector(STRSXP, totals.size());
+    SET_VECTOR_ELT(res, 0, subsystems);
+    SEXP bytes = Rf_allocVector(REALSXP, totals.size());
+    SET_VECTOR_ELT(res, 1, bytes);
+    for (size_t i = 0; i < totals.size(); ++i) {
+        SET_STRING_ELT(subsystems, i, Rf_mkChar(totals[i].first.c_str()));
+        REAL(bytes)[i] = totals[i].second;
+    }
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(names, 0, Rf_mkChar("subsystem"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("bytes"));
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return res;
+}
+
+REXPORT SEXP rirMemoryDump(SEXP file, SEXP what) {
+    if (TYPEOF(file) != STRSXP || LENGTH(file) != 1)
+        Rf_error("file should be a string");
+    checkClosureList(what);
+    std::ofstream out(CHAR(STRING_ELT(file, 0)));
+    if (!out)
+        Rf_error("couldn't open file at path");
+
+    out << "{\"totals\":{";
+    auto totals = memoryTotals();
+    for (size_t i = 0; i < totals.size(); ++i) {
+        if (i)
+            out << ",";
+        writeJsonString(out, totals[i].first.c_str());
+        out << ":" << totals[i].second;
+    }
+    out << "},\n\"closures\":[";
+    SEXP names = Rf_getAttrib(what, R_NamesSymbol);
+    for (R_xlen_t i = 0; i < XLENGTH(what); ++i) {
+        out << (i ? ",\n" : "\n") << "{\"name\":";
+        writeJsonString(out,
+                        names != R_NilValue ? CHAR(STRING_ELT(names, i)) : "");
+        auto row = closureMemoryRow(VECTOR_ELT(what, i));
+        for (size_t c = 0; c < row.size(); ++c) {
+            out << ",";
+            writeJsonString(out, closureMemoryColumns[c]);
+            out << ":" << row[c];
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+    return R_NilValue;
+}
+
+REXPORT SEXP rirCodeCacheBudget(SEXP bytes) {
+    auto old = Rf_ScalarReal(pir::Parameter::RIR_CODE_CACHE_BUDGET);
+    if (bytes != R_NilValue) {
+        auto b = Rf_asReal(bytes);
+        if (ISNAN(b) || b < 0)
+            Rf_error("budget should be a non-negative number of bytes");
+        pir::Parameter::RIR_CODE_CACHE_BUDGET = b;
+    }
+    return old;
+}
+
+REXPORT SEXP rirCompileDump(SEXP dir) {
+    auto old = compileDumpDir.empty() ? R_NilValue
+                                      : Rf_mkString(compileDumpDir.c_str());
+    if (dir == R_NilValue) {
+        compileDumpDir.clear();
+    } else {
+        if (TYPEOF(dir) != STRSXP || LENGTH(dir) != 1)
+            Rf_error("dir should be a string or NULL");
+        compileDumpDir = CHAR(STRING_ELT(dir, 0));
+    }
+    return old;
+}
+
+REXPORT SEXP rirTraceFlush(SEXP file) {
+    if (TYPEOF(file) != STRSXP || LENGTH(file) != 1)
+        Rf_error("file should be a string");
+    return Rf_ScalarLogical(Tracing::flush(CHAR(STRING_ELT(file, 0))));
+}
+
 REXPORT SEXP pirCompileWrapper(SEXP what, SEXP name, SEXP debugFlags,
                                SEXP debugStyle) {
     if (debugFlags != R_NilValue &&
@@ -456,20 +812,295 @@ REXPORT SEXP rirSerialize(SEXP data, SEXP fileSexp) {
     return R_NilValue;
 }
 
-REXPORT SEXP rirDeserialize(SEXP fileSexp) {
-    oldPreserve = pir::Parameter::RIR_PRESERVE;
+// Loads a file written with RIR_PRESERVE. The flag is restored even if the
+// file can't be read and loadMappedFile errors out.
+static SEXP loadPreservedFile(const char* path) {
+    struct Load {
+        const char* path;
+        bool preserve;
+    } load = {path, pir::Parameter::RIR_PRESERVE};
     pir::Parameter::RIR_PRESERVE = true;
+    return R_ExecWithCleanup(
+        [](void* data) { return loadMappedFile(((Load*)data)->path); }, &load,
+        [](void* data) {
+            pir::Parameter::RIR_PRESERVE = ((Load*)data)->preserve;
+        },
+        &load);
+}
+
+REXPORT SEXP rirDeserialize(SEXP fileSexp) {
     if (TYPEOF(fileSexp) != STRSXP)
         Rf_error("must provide a string path");
-    FILE* file = fopen(CHAR(Rf_asChar(fileSexp)), "r");
-    if (file == NULL)
-        Rf_error("couldn't open file at path");
-    SEXP res = R_LoadFromFile(file, 0);
-    fclose(file);
-    pir::Parameter::RIR_PRESERVE = oldPreserve;
+    return loadPreservedFile(CHAR(Rf_asChar(fileSexp)));
+}
+
+REXPORT SEXP rirReplayCompile(SEXP fileSexp) {
+    if (TYPEOF(fileSexp) != STRSXP)
+        Rf_error("must provide a string path");
+    SEXP dump = PROTECT(loadPreservedFile(CHAR(Rf_asChar(fileSexp))));
+
+    if (TYPEOF(dump) != VECSXP || LENGTH(dump) != 3 ||
+        TYPEOF(VECTOR_ELT(dump, 1)) != RAWSXP ||
+        LENGTH(VECTOR_ELT(dump, 1)) != sizeof(Context))
+        Rf_error("not a compile dump");
+    SEXP what = VECTOR_ELT(dump, 0);
+    Context assumptions;
+    memcpy(&assumptions, RAW(VECTOR_ELT(dump, 1)), sizeof(Context));
+    std::string name = CHAR(Rf_asChar(VECTOR_ELT(dump, 2)));
+
+    auto start = std::chrono::steady_clock::now();
+    pirCompile(what, assumptions, name, PirDebug);
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, 2));
+    SET_VECTOR_ELT(res, 0, what);
+    SET_VECTOR_ELT(res, 1, Rf_ScalarReal(time.count()));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(names, 0, Rf_mkChar("closure"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("compileTime"));
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(3);
     return res;
 }
 
+// The source of a closure, as the rir compiler sees it
+static SEXP closureBodyAst(SEXP closure) {
+    SEXP body = BODY(closure);
+    if (TYPEOF(body) == BCODESXP)
+        return VECTOR_ELT(CDR(body), 0);
+    return rirDecompile(body);
+}
+
+// Lazy loaded namespaces bind promises until a binding is first used
+static SEXP namespaceBinding(SEXP ns, SEXP name) {
+    SEXP value = Rf_findVarInFrame(ns, name);
+    if (TYPEOF(value) == PROMSXP)
+        value = Rf_eval(value, R_BaseEnv);
+    return value;
+}
+
+// A namespace cache is a list of the namespace spec (name and version) and,
+// per closure, its name, formals, body and the rir baseline compiled from
+// them. It is written with RIR_PRESERVE, i.e. with Function::serialize.
+struct NamespaceCache {
+    enum Entry { Spec, Names, Formals, Bodies, Baselines, Length };
+};
+
+REXPORT SEXP rirCompileNamespace(SEXP ns, SEXP spec, SEXP fileSexp) {
+    if (!R_IsNamespaceEnv(ns))
+        Rf_error("not a namespace");
+    if (TYPEOF(fileSexp) != STRSXP)
+        Rf_error("must provide a string path");
+
+    SEXP all = PROTECT(R_lsInternal3(ns, TRUE, FALSE));
+    std::vector<std::pair<SEXP, SEXP>> closures;
+    for (R_xlen_t i = 0; i < XLENGTH(all); ++i) {
+        SEXP f = namespaceBinding(ns, Rf_installChar(STRING_ELT(all, i)));
+        if (TYPEOF(f) != CLOSXP)
+            continue;
+        rirCompile(f, R_NilValue);
+        if (DispatchTable::check(BODY(f)))
+            closures.emplace_back(STRING_ELT(all, i), f);
+    }
+
+    SEXP cache = PROTECT(Rf_allocVector(VECSXP, NamespaceCache::Length));
+    SET_VECTOR_ELT(cache, NamespaceCache::Spec, spec);
+    SEXP names = Rf_allocVector(STRSXP, closures.size());
+    SET_VECTOR_ELT(cache, NamespaceCache::Names, names);
+    SEXP formals = Rf_allocVector(VECSXP, closures.size());
+    SET_VECTOR_ELT(cache, NamespaceCache::Formals, formals);
+    SEXP bodies = Rf_allocVector(VECSXP, closures.size());
+    SET_VECTOR_ELT(cache, NamespaceCache::Bodies, bodies);
+    SEXP baselines = Rf_allocVector(VECSXP, closures.size());
+    SET_VECTOR_ELT(cache, NamespaceCache::Baselines, baselines);
+
+    for (size_t i = 0; i < closures.size(); ++i) {
+        SEXP f = closures[i].second;
+        SET_STRING_ELT(names, i, closures[i].first);
+        SET_VECTOR_ELT(formals, i, FORMALS(f));
+        SET_VECTOR_ELT(bodies, i, closureBodyAst(f));
+        SET_VECTOR_ELT(baselines, i,
+                       DispatchTable::unpack(BODY(f))->baseline()->container());
+    }
+
+    rirSerialize(cache, fileSexp);
+    UNPROTECT(2);
+    return Rf_ScalarInteger(closures.size());
+}
+
+REXPORT SEXP rirLoadNamespaceCache(SEXP fileSexp) {
+    SEXP cache = PROTECT(rirDeserialize(fileSexp));
+    if (TYPEOF(cache) != VECSXP || LENGTH(cache) != NamespaceCache::Length ||
+        TYPEOF(VECTOR_ELT(cache, NamespaceCache::Spec)) != STRSXP ||
+        TYPEOF(VECTOR_ELT(cache, NamespaceCache::Names)) != STRSXP)
+        Rf_error("not a namespace cache");
+    SEXP spec = VECTOR_ELT(cache, NamespaceCache::Spec);
+    SEXP names = VECTOR_ELT(cache, NamespaceCache::Names);
+    SEXP formals = VECTOR_ELT(cache, NamespaceCache::Formals);
+    SEXP bodies = VECTOR_ELT(cache, NamespaceCache::Bodies);
+    SEXP baselines = VECTOR_ELT(cache, NamespaceCache::Baselines);
+
+    // A cache of another version of the package is ignored as a whole
+    SEXP ns = R_FindNamespace(Rf_ScalarString(STRING_ELT(spec, 0)));
+    PROTECT(ns);
+    SEXP info = Rf_findVarInFrame(ns, Rf_install(".__NAMESPACE__."));
+    if (info == R_UnboundValue ||
+        !R_compute_identical(Rf_findVarInFrame(info, Rf_install("spec")),
+                             spec, 16)) {
+        UNPROTECT(2);
+        return Rf_ScalarInteger(0);
+    }
+
+    // Closures that changed since the cache was written are skipped. A
+    // baseline bound to several names is only installed once.
+    int installed = 0;
+    std::unordered_set<SEXP> used;
+    for (R_xlen_t i = 0; i < XLENGTH(names); ++i) {
+        SEXP f = PROTECT(
+            namespaceBinding(ns, Rf_installChar(STRING_ELT(names, i))));
+        if (TYPEOF(f) != CLOSXP || TYPEOF(BODY(f)) == EXTERNALSXP ||
+            !used.insert(VECTOR_ELT(baselines, i)).second ||
+            !R_compute_identical(FORMALS(f), VECTOR_ELT(formals, i), 16) ||
+            !R_compute_identical(closureBodyAst(f), VECTOR_ELT(bodies, i),
+                                 16)) {
+            UNPROTECT(1);
+            continue;
+        }
+
+        // Same as Compiler::compileClosure
+        DispatchTable* table = DispatchTable::create();
+        PROTECT(table->container());
+        table->baseline(Function::unpack(VECTOR_ELT(baselines, i)));
+        if (TYPEOF(BODY(f)) == BCODESXP)
+            table->baseline()->body()->addExtraPoolEntry(BODY(f));
+        SET_BODY(f, table->container());
+        installed++;
+        UNPROTECT(2);
+    }
+
+    UNPROTECT(2);
+    return Rf_ScalarInteger(installed);
+}
+
+// Structural hash of an AST, attributes (ie. srcrefs) are ignored such that
+// it is stable between runs
+static size_t astHash(SEXP ast) {
+    size_t h = TYPEOF(ast);
+    switch (TYPEOF(ast)) {
+    case SYMSXP:
+        return hash_combine(h, std::string(CHAR(PRINTNAME(ast))));
+    case CHARSXP:
+        return ast == NA_STRING ? h : hash_combine(h, std::string(CHAR(ast)));
+    case LISTSXP:
+    case LANGSXP:
+        for (; ast != R_NilValue; ast = CDR(ast))
+            h = hash_combine(hash_combine(h, astHash(TAG(ast))),
+                             astHash(CAR(ast)));
+        return h;
+    case STRSXP:
+        for (R_xlen_t i = 0; i < XLENGTH(ast); ++i)
+            h = hash_combine(h, astHash(STRING_ELT(ast, i)));
+        return h;
+    case RAWSXP:
+        return hash_combine(
+            h, std::string((const char*)RAW(ast), XLENGTH(ast)));
+    case LGLSXP:
+    case INTSXP:
+        return hash_combine(h, std::string((const char*)INTEGER(ast),
+                                           XLENGTH(ast) * sizeof(int)));
+    case REALSXP:
+        return hash_combine(h, std::string((const char*)REAL(ast),
+                                           XLENGTH(ast) * sizeof(double)));
+    case CPLXSXP:
+        return hash_combine(h, std::string((const char*)COMPLEX(ast),
+                                           XLENGTH(ast) * sizeof(Rcomplex)));
+    default:
+        return h;
+    }
+}
+
+static std::string closureHash(SEXP closure) {
+    std::stringstream key;
+    key << std::hex
+        << hash_combine(astHash(FORMALS(closure)),
+                        astHash(closureBodyAst(closure)));
+    return key.str();
+}
+
+// A feedback profile is a list of the baselines of closures, named by the
+// closure hash. It is written with RIR_PRESERVE, such that the baselines
+// include their type feedback.
+REXPORT SEXP rirSaveFeedback(SEXP what, SEXP fileSexp) {
+    if (TYPEOF(what) != VECSXP)
+        Rf_error("expected a list of closures");
+    if (TYPEOF(fileSexp) != STRSXP)
+        Rf_error("must provide a string path");
+
+    std::vector<SEXP> closures;
+    for (R_xlen_t i = 0; i < XLENGTH(what); ++i) {
+        SEXP f = VECTOR_ELT(what, i);
+        if (TYPEOF(f) == CLOSXP && DispatchTable::check(BODY(f)))
+            closures.push_back(f);
+    }
+
+    SEXP profile = PROTECT(Rf_allocVector(VECSXP, closures.size()));
+    SEXP names = Rf_allocVector(STRSXP, closures.size());
+    Rf_setAttrib(profile, R_NamesSymbol, names);
+    for (size_t i = 0; i < closures.size(); ++i) {
+        SEXP f = closures[i];
+        SET_STRING_ELT(names, i, Rf_mkChar(closureHash(f).c_str()));
+        SET_VECTOR_ELT(profile, i,
+                       DispatchTable::unpack(BODY(f))->baseline()->container());
+    }
+
+    rirSerialize(profile, fileSexp);
+    UNPROTECT(1);
+    return Rf_ScalarInteger(closures.size());
+}
+
+REXPORT SEXP rirPrecompile(SEXP what, SEXP fileSexp) {
+    if (TYPEOF(what) != VECSXP)
+        Rf_error("expected a list of closures");
+    SEXP profile = PROTECT(rirDeserialize(fileSexp));
+    SEXP hashes = Rf_getAttrib(profile, R_NamesSymbol);
+    if (TYPEOF(profile) != VECSXP || TYPEOF(hashes) != STRSXP)
+        Rf_error("not a feedback profile");
+
+    std::unordered_map<std::string, Function*> saved;
+    for (R_xlen_t i = 0; i < XLENGTH(profile); ++i)
+        if (auto fun = Function::check(VECTOR_ELT(profile, i)))
+            saved.emplace(CHAR(STRING_ELT(hashes, i)), fun);
+
+    // The imported feedback is only a starting point, the optimized versions
+    // keep their assumptions and deopt as usual if the program behaves
+    // differently than in the profiled run
+    SEXP names = Rf_getAttrib(what, R_NamesSymbol);
+    int compiled = 0;
+    for (R_xlen_t i = 0; i < XLENGTH(what); ++i) {
+        SEXP f = VECTOR_ELT(what, i);
+        if (TYPEOF(f) != CLOSXP)
+            continue;
+        auto match = saved.find(closureHash(f));
+        if (match == saved.end())
+            continue;
+        rirCompile(f, CLOENV(f));
+        if (!DispatchTable::check(BODY(f)))
+            continue;
+        auto baseline = DispatchTable::unpack(BODY(f))->baseline();
+        if (!baseline->body()->importFeedback(match->second->body()))
+            continue;
+        std::string name;
+        if (names != R_NilValue)
+            name = CHAR(STRING_ELT(names, i));
+        pirCompile(f, pir::Compiler::defaultContext, name, PirDebug);
+        compiled++;
+    }
+
+    UNPROTECT(1);
+    return Rf_ScalarInteger(compiled);
+}
+
 REXPORT SEXP rirEnableLoopPeeling() {
     Compiler::loopPeelingEnabled = true;
     return R_NilValue;
@@ -12,6 +12,16 @@ extern int R_ENABLE_JIT;
 extern rir::pir::DebugOptions PirDebug;
 
 REXPORT SEXP rirInvocationCount(SEXP what);
+REXPORT SEXP rirFeedback(SEXP what);
+REXPORT SEXP rirResetFeedback(SEXP what);
+REXPORT SEXP rirStats(SEXP what);
+REXPORT SEXP rirRuntimeStats(SEXP reset);
+REXPORT SEXP rirMemory(SEXP what);
+REXPORT SEXP rirMemoryTotals();
+REXPORT SEXP rirMemoryDump(SEXP file, SEXP what);
+REXPORT SEXP rirCodeCacheBudget(SEXP bytes);
+REXPORT SEXP rirCompileDump(SEXP dir);
+REXPORT SEXP rirTraceFlush(SEXP file);
 REXPORT SEXP pirCompileWrapper(SEXP closure, SEXP name, SEXP debugFlags,
                                SEXP debugStyle);
 REXPORT SEXP rirCompile(SEXP what, SEXP env);
@@ -25,6 +35,11 @@ extern SEXP rirOptDefaultOptsDryrun(SEXP closure, const rir::Context&,
                                     SEXP name);
 REXPORT SEXP rirSerialize(SEXP data, SEXP file);
 REXPORT SEXP rirDeserialize(SEXP file);
+REXPORT SEXP rirReplayCompile(SEXP file);
+REXPORT SEXP rirCompileNamespace(SEXP ns, SEXP spec, SEXP file);
+REXPORT SEXP rirLoadNamespaceCache(SEXP file);
+REXPORT SEXP rirSaveFeedback(SEXP what, SEXP file);
+REXPORT SEXP rirPrecompile(SEXP what, SEXP file);
 
 REXPORT SEXP rirSetUserContext(SEXP f, SEXP udc);
 REXPORT SEXP rirCreateSimpleIntContext();
@@ -0,0 +1,153 @@
+#include "induction_variables.h"
+#include "../pir/pir_impl.h"
+#include "R/r.h"
+
+#include <cstdlib>
+
+namespace rir {
+namespace pir {
+
+// Bounds the length of Inc/Add/Sub chains we look through, and the size of
+// the constants involved, such that offsets cannot overflow.
+static constexpr unsigned MAX_CHAIN = 8;
+static constexpr int MAX_CONSTANT = 1 << 20;
+
+bool InductionVariables::intConstant(Value* v, int& res) {
+    auto ld = LdConst::Cast(v);
+    if (!ld || !IS_SIMPLE_SCALAR(ld->c(), INTSXP))
+        return false;
+    auto c = INTEGER(ld->c())[0];
+    if (c == NA_INTEGER || std::abs(c) > MAX_CONSTANT)
+        return false;
+    res = c;
+    return true;
+}
+
+Value* InductionVariables::stripOffset(Value* v, int& offset) {
+    offset = 0;
+    for (unsigned depth = 0; depth < MAX_CHAIN; ++depth) {
+        auto i = Instruction::Cast(v);
+        if (!i)
+            return v;
+
+        // Inc is only used for the for-loop index and never produces NA
+        if (auto inc = Inc::Cast(i)) {
+            offset++;
+            v = inc->arg(0).val();
+            continue;
+        }
+
+        // Additions which can overflow produce NA, thus they are only
+        // induction variables if we know they do not
+        if (!(Add::Cast(i) || Sub::Cast(i)) ||
+            i->effects.contains(Effect::ExecuteCode) ||
+            !i->type.isA(PirType(RType::integer).simpleScalar().notNAOrNaN()))
+            return v;
+
+        int c;
+        if (intConstant(i->arg(1).val(), c)) {
+            offset += Add::Cast(i) ? c : -c;
+            v = i->arg(0).val();
+        } else if (Add::Cast(i) && intConstant(i->arg(0).val(), c)) {
+            offset += c;
+            v = i->arg(1).val();
+        } else {
+            return v;
+        }
+    }
+    return v;
+}
+
+InductionVariables::InductionVariables(Code* code) {
+    LoopDetection loops(code);
+    for (auto& loop : loops) {
+        for (auto i : *loop.header()) {
+            auto phi = Phi::Cast(i);
+            if (!phi)
+                continue;
+
+            Value* init = nullptr;
+            bool ok = true;
+            bool first = true;
+            int step = 0;
+            phi->eachArg([&](BB* in, Value* v) {
+                if (!ok)
+                    return;
+                if (!loop.contains(in)) {
+                    if (init)
+                        ok = false;
+                    init = v;
+                    return;
+                }
+                int offset;
+                if (stripOffset(v, offset) != phi ||
+                    (!first && offset != step)) {
+                    ok = false;
+                    return;
+                }
+                step = offset;
+                first = false;
+            });
+
+            if (ok && init && !first)
+                basic_.emplace(phi, BasicInductionVariable{loop.header(), init,
+                                                           step});
+        }
+    }
+}
+
+const InductionVariables::BasicInductionVariable*
+InductionVariables::basic(Value* v) const {
+    auto phi = Phi::Cast(v);
+    if (!phi)
+        return nullptr;
+    auto iv = basic_.find(phi);
+    if (iv == basic_.end())
+        return nullptr;
+    return &iv->second;
+}
+
+bool InductionVariables::get(Value* v, InductionVariable& res) const {
+    int offset;
+    auto base = stripOffset(v, offset);
+    if (!basic(base))
+        return false;
+    res.base = Phi::Cast(base);
+    res.offset = offset;
+    return true;
+}
+
+bool InductionVariables::lowerBound(Value* v, int& res) const {
+    return lowerBound(v, res, 0);
+}
+
+bool InductionVariables::lowerBound(Value* v, int& res,
+                                    unsigned depth) const {
+    if (depth > MAX_CHAIN)
+        return false;
+
+    if (intConstant(v, res))
+        return true;
+
+    int offset;
+    auto base = stripOffset(v, offset);
+    if (base != v) {
+        int lb;
+        if (!lowerBound(base, lb, depth + 1) || lb < -MAX_CONSTANT ||
+            lb > MAX_CONSTANT)
+            return false;
+        res = lb + offset;
+        return true;
+    }
+
+    if (auto iv = basic(v)) {
+        if (iv->step < 0)
+            return false;
+        return lowerBound(iv->init, res, depth + 1);
+    }
+
+    return false;
+}
+
+} // namespace pir
+} // namespace rir
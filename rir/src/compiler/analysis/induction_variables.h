@@ -0,0 +1,59 @@
+#ifndef PIR_INDUCTION_VARIABLES_H
+#define PIR_INDUCTION_VARIABLES_H
+
+#include "compiler/analysis/loop_detection.h"
+#include "compiler/pir/pir.h"
+
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Finds the induction variables of all loops.
+ *
+ * A basic induction variable is a phi in the loop header, which has exactly
+ * one input from outside the loop (the initial value) and where all inputs
+ * from the back edges add the same constant step to the phi. R for loops
+ * produce such a counter (the `inc` on the hidden loop index).
+ *
+ * Derived induction variables are integer additions and subtractions of a
+ * constant to a basic induction variable.
+ */
+class InductionVariables {
+  public:
+    struct BasicInductionVariable {
+        BB* header;
+        Value* init;
+        int step;
+    };
+
+    // The value of a (derived) induction variable is `base + offset`
+    struct InductionVariable {
+        Phi* base;
+        int offset;
+    };
+
+    explicit InductionVariables(Code* code);
+
+    const BasicInductionVariable* basic(Value* v) const;
+    bool get(Value* v, InductionVariable& res) const;
+
+    // A lower bound for v which holds at every point where v is defined.
+    // Only known for constants and induction variables which are counting
+    // upwards from a known lower bound.
+    bool lowerBound(Value* v, int& res) const;
+
+    static bool intConstant(Value* v, int& res);
+
+  private:
+    static Value* stripOffset(Value* v, int& offset);
+    bool lowerBound(Value* v, int& res, unsigned depth) const;
+
+    std::unordered_map<Phi*, BasicInductionVariable> basic_;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
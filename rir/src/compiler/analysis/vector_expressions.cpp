@@ -0,0 +1,101 @@
+#include "vector_expressions.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "compiler/analysis/cfg.h"
+
+#include <functional>
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+bool VectorExpressions::isOperand(Value* v) {
+    return v->type.isA(PirType(RType::real).noAttribsOrObject()) ||
+           v->type.isA(PirType(RType::integer).noAttribsOrObject());
+}
+
+bool VectorExpressions::isOperation(Instruction* i) {
+    switch (i->tag) {
+    case Tag::Add:
+    case Tag::Sub:
+    case Tag::Mul:
+    case Tag::Div:
+        break;
+    default:
+        return false;
+    }
+    return !i->hasEnv() && !i->effects.contains(Effect::ExecuteCode) &&
+           i->type.isA(PirType(RType::real).noAttribsOrObject()) &&
+           isOperand(i->arg(0).val()) && isOperand(i->arg(1).val());
+}
+
+bool VectorExpressions::Expression::contiguous() const {
+    auto bb = root->bb();
+    auto pos = bb->indexOf(root);
+    if (pos + 1 < nodes.size())
+        return false;
+    std::unordered_set<Instruction*> members(nodes.begin(), nodes.end());
+    for (size_t i = pos + 1 - nodes.size(); i < pos; ++i)
+        if (!members.count(bb->at(i)))
+            return false;
+    return true;
+}
+
+VectorExpressions::VectorExpressions(Code* code) {
+    UsesTree uses(code);
+
+    Visitor::run(code->entry, [&](BB* bb) {
+        // Going backwards we see the roots before the inner nodes
+        for (auto it = bb->rbegin(); it != bb->rend(); ++it) {
+            auto root = *it;
+            if (nodes.count(root) || !isOperation(root) ||
+                root->type.isScalar())
+                continue;
+
+            Expression e;
+            e.root = root;
+            std::unordered_set<Instruction*> seen;
+            std::function<void(Instruction*)> collect = [&](Instruction* i) {
+                if (!seen.insert(i).second)
+                    return;
+                for (size_t j = 0; j < 2; ++j) {
+                    auto v = i->arg(j).val();
+                    auto arg = Instruction::Cast(v);
+                    if (arg && arg->bb() == bb && !nodes.count(arg) &&
+                        isOperation(arg)) {
+                        auto& argUses = uses.at(arg);
+                        if (argUses.size() == 1 && argUses.includes(i)) {
+                            collect(arg);
+                            continue;
+                        }
+                    }
+                    e.leaves.push_back(v);
+                }
+                e.nodes.push_back(i);
+            };
+            collect(root);
+
+            bool anyVector = false;
+            for (auto l : e.leaves)
+                if (!l->type.isScalar())
+                    anyVector = true;
+            if (e.nodes.size() < 2 || !anyVector)
+                continue;
+
+            expressions.push_back(e);
+            for (auto n : e.nodes)
+                nodes[n] = &expressions.back();
+        }
+    });
+}
+
+const VectorExpressions::Expression*
+VectorExpressions::at(Instruction* i) const {
+    auto e = nodes.find(i);
+    if (e == nodes.end())
+        return nullptr;
+    return e->second;
+}
+
+} // namespace pir
+} // namespace rir
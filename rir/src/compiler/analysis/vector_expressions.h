@@ -0,0 +1,59 @@
+#ifndef PIR_VECTOR_EXPRESSIONS_H
+#define PIR_VECTOR_EXPRESSIONS_H
+
+#include "compiler/pir/pir.h"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Finds trees of element-wise arithmetic (+, -, *, /) on double vectors
+ * without attributes, such as `a * b + c * d`. All inner nodes of a tree are
+ * used exactly once, by their parent, and they are in the same basic block
+ * as the root. The operands (leaves) are integer or double vectors and
+ * scalars without attributes.
+ *
+ * Such a tree can be computed in one loop over the elements, without
+ * allocating the intermediate vectors.
+ */
+class VectorExpressions {
+  public:
+    struct Expression {
+        Instruction* root;
+        // The operations in evaluation order, the root is last
+        std::vector<Instruction*> nodes;
+        // The operands, which are not computed by the tree
+        std::vector<Value*> leaves;
+
+        // True if all nodes immediately precede the root in its BB
+        bool contiguous() const;
+    };
+
+    explicit VectorExpressions(Code* code);
+
+    // The expression which contains the node i, or nullptr
+    const Expression* at(Instruction* i) const;
+
+    std::list<Expression>::const_iterator begin() const {
+        return expressions.begin();
+    }
+    std::list<Expression>::const_iterator end() const {
+        return expressions.end();
+    }
+
+    static bool isOperand(Value* v);
+    static bool isOperation(Instruction* i);
+
+  private:
+    std::list<Expression> expressions;
+    std::unordered_map<Instruction*, Expression*> nodes;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
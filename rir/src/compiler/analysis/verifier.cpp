@@ -395,7 +395,7 @@ class TheVerifier {
             Tag::MkArg};
         if (i->hasEnv() && !allowStub.count(i->tag)) {
             auto env = MkEnv::Cast(i->env());
-            if (env && env->stub) {
+            if (env && (env->stub || env->checkedStub)) {
                 std::cerr << "Error at instruction '";
                 i->print(std::cerr);
                 std::cerr << " that uses a stub environment\n";
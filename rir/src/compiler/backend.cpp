@@ -19,6 +19,7 @@
 #include "simple_instruction_list.h"
 #include "utils/FunctionWriter.h"
 #include "utils/measuring.h"
+#include "utils/tracing.h"
 
 #include <algorithm>
 #include <chrono>
@@ -325,6 +326,8 @@ rir::Function* Backend::doCompile(ClosureVersion* cls,
 
     if (MEASURE_COMPILER_BACKEND_PERF)
         Measuring::startTimer("backend.cpp: lowering");
+    if (Tracing::enabled)
+        Tracing::begin("jit", "lowering", cls->name());
 
     FunctionWriter function;
 
@@ -375,6 +378,10 @@ rir::Function* Backend::doCompile(ClosureVersion* cls,
         Measuring::countTimer("backend.cpp: lowering");
         Measuring::startTimer("backend.cpp: pir2llvm");
     }
+    if (Tracing::enabled) {
+        Tracing::end("jit", "lowering");
+        Tracing::begin("jit", "pir2llvm", cls->name());
+    }
 
     std::unordered_map<Code*, rir::Code*> done;
     std::function<rir::Code*(Code*)> compile = [&](Code* c) {
@@ -407,6 +414,8 @@ rir::Function* Backend::doCompile(ClosureVersion* cls,
         Measuring::countTimer("backend.cpp: pir2llvm");
         Measuring::startTimer("backend.cpp: llvm");
     }
+    if (Tracing::enabled)
+        Tracing::end("jit", "pir2llvm");
 
     log.finalPIR(cls);
     function.finalize(body, signature, cls->context());
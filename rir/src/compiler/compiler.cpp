@@ -4,6 +4,7 @@
 #include "rir2pir/rir2pir.h"
 #include "utils/Map.h"
 #include "utils/measuring.h"
+#include "utils/tracing.h"
 
 #include "compiler/analysis/query.h"
 #include "compiler/analysis/verifier.h"
@@ -187,7 +188,12 @@ void Compiler::compileClosure(Closure* closure, rir::Function* optFunction,
         return fail();
     }
 
-    if (rir2pir.tryCompile(builder)) {
+    bool translated;
+    {
+        Tracing::Scope trace("jit", "rir2pir", closure->name());
+        translated = rir2pir.tryCompile(builder);
+    }
+    if (translated) {
         log.compilationEarlyPir(version);
 #ifdef FULLVERIFIER
         Verify::apply(version, "Error after initial translation", true);
@@ -299,8 +305,13 @@ void Compiler::optimizeModule() {
                     Measuring::startTimer("compiler.cpp: " +
                                           translation->getName());
 
-                if (translation->apply(*this, v, log.out()))
-                    changed = true;
+                {
+                    Tracing::Scope trace(
+                        "jit", "pass",
+                        Tracing::enabled ? translation->getName() : "");
+                    if (translation->apply(*this, v, log.out()))
+                        changed = true;
+                }
                 if (MEASURE_COMPILER_PERF)
                     Measuring::countTimer("compiler.cpp: " +
                                           translation->getName());
@@ -9,6 +9,8 @@
 #include "runtime/LazyArglist.h"
 #include "runtime/LazyEnvironment.h"
 #include "utils/Pool.h"
+#include "utils/measuring.h"
+#include "utils/tracing.h"
 
 #include "R/Funtab.h"
 #include "R/Symbols.h"
@@ -16,6 +18,8 @@
 
 #include "llvm/IR/Attributes.h"
 
+#include <algorithm>
+
 namespace rir {
 namespace pir {
 
@@ -73,9 +77,10 @@ SEXP createEnvironmentImpl(SEXP parent, SEXP arglist, int contextPos) {
 }
 
 SEXP createStubEnvironmentImpl(SEXP parent, int n, Immediate* names,
-                               int contextPos) {
+                               LazyEnvironmentSlots* slots, int contextPos) {
     SLOWASSERT(TYPEOF(parent) == ENVSXP);
-    SEXP res = LazyEnvironment::BasicNew(parent, n, names)->container();
+    SEXP res =
+        LazyEnvironment::BasicNew(parent, n, names, slots)->container();
     if (contextPos > 0) {
         if (auto cptr = getFunctionContext(contextPos - 1)) {
             cptr->cloenv = res;
@@ -111,7 +116,7 @@ SEXP ldvarForUpdateImpl(SEXP sym, SEXP env) {
 }
 
 SEXP ldvarImpl(SEXP a, SEXP b) {
-    auto res = Rf_findVar(a, b);
+    auto res = cachedFindVar(a, b);
     // std::cout << CHAR(PRINTNAME(a)) << "=";
     // Rf_PrintValue(res);
     ENSURE_NAMED(res);
@@ -227,7 +232,7 @@ SEXP chkfunImpl(SEXP sym, SEXP res) {
 }
 
 SEXP ldfunImpl(SEXP sym, SEXP env) {
-    SEXP res = Rf_findFun(sym, env);
+    SEXP res = cachedFindFun(sym, env);
 
     // TODO something should happen here
     if (res == R_UnboundValue)
@@ -735,19 +740,56 @@ static SEXP deoptSentinelContainer = []() {
     return store;
 }();
 
-void deoptImpl(Code* c, SEXP cls, DeoptMetadata* m, R_bcstack_t* args) {
+void NativeBuiltins::invalidateTargetCaches(rir::Code* c) {
+    for (auto idx : targetCaches)
+        if (auto f = Function::check(Pool::get(idx)))
+            if (f->body() == c)
+                Pool::patch(idx, deoptSentinelContainer);
+}
+
+void NativeBuiltins::forgetTargetCaches(const std::vector<BC::PoolIdx>& freed) {
+    if (freed.empty())
+        return;
+    targetCaches.erase(
+        std::remove_if(targetCaches.begin(), targetCaches.end(),
+                       [&](BC::PoolIdx idx) {
+                           return std::binary_search(freed.begin(),
+                                                     freed.end(), idx);
+                       }),
+        targetCaches.end());
+}
+
+void deoptImpl(Code* c, SEXP cls, const uint8_t* compressed,
+               R_bcstack_t* args) {
+    // Not on the heap, since we long-jump out of the deopt
+    auto m = (DeoptMetadata*)alloca(
+        DeoptMetadata::size(DeoptMetadata::numFramesOf(compressed)));
+    DeoptMetadata::decompress(compressed, m);
     assert(m->numFrames >= 1);
-    size_t stackHeight = 0;
-    for (size_t i = 0; i < m->numFrames; ++i) {
-        stackHeight += m->frames[i].stackSize + 1;
-    }
+    size_t stackHeight = m->stackHeight;
 
     c->registerDeopt();
+    // This version deopted too often. The feedback it was compiled from is
+    // likely stale, thus the next version should only see fresh feedback.
+    // The observation that caused this deopt was already recorded by
+    // RecordDeoptReason and is kept.
+    if (auto dt = DispatchTable::check(BODY(cls))) {
+        if (c->deoptCount == pir::Parameter::DEOPT_ABANDON)
+            dt->baseline()->resetFeedback(lastDeoptOrigin);
+        auto storm = dt->registerDeopt(c);
+        if (Tracing::enabled)
+            Tracing::instant("deopt", storm ? "deopt storm" : "deopt");
+        if (MEASURE_DEOPTS) {
+            Measuring::countEvent("deopt");
+            if (storm)
+                Measuring::countEvent("deopt storm");
+            if (dt->recompileBackoff() == DispatchTable::MaxRecompileBackoff)
+                Measuring::countEvent("deopt storm, maximal backoff");
+        }
+    }
+    lastDeoptOrigin = nullptr;
     // Invalidate target caches pointing to deoptimized version
-    for (auto idx : NativeBuiltins::targetCaches)
-        if (auto f = Function::check(Pool::get(idx)))
-            if (f->body() == c)
-                Pool::patch(idx, deoptSentinelContainer);
+    NativeBuiltins::invalidateTargetCaches(c);
 
     SEXP env =
         ostack_at(ctx, stackHeight - m->frames[m->numFrames - 1].stackSize - 1);
@@ -1967,8 +2009,8 @@ void NativeBuiltins::initializeBuiltins() {
         llvm::FunctionType::get(t::SEXP, {t::SEXP, t::SEXP, t::Int}, false)};
     get_(Id::createStubEnvironment) = {
         "createStubEnvironment", (void*)&createStubEnvironmentImpl,
-        llvm::FunctionType::get(t::SEXP, {t::SEXP, t::Int, t::IntPtr, t::Int},
-                                false)};
+        llvm::FunctionType::get(
+            t::SEXP, {t::SEXP, t::Int, t::IntPtr, t::i8ptr, t::Int}, false)};
     get_(Id::materializeEnvironment) = {
         "materializeEnvironment", (void*)&materializeEnvironmentImpl,
         llvm::FunctionType::get(t::SEXP, {t::SEXP}, false)};
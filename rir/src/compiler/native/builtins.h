@@ -21,6 +21,8 @@ class FunctionType;
 }
 
 namespace rir {
+struct Code;
+
 namespace pir {
 
 struct NativeBuiltin {
@@ -179,6 +181,10 @@ struct NativeBuiltins {
     static void initializeBuiltins();
 
     static std::vector<BC::PoolIdx> targetCaches;
+    // Points the target caches of native calls to c to a deoptimized sentinel
+    static void invalidateTargetCaches(rir::Code* c);
+    // Drops the target caches whose pool entries were freed
+    static void forgetTargetCaches(const std::vector<BC::PoolIdx>& freed);
 
   private:
     // For setting up - returns mutable reference
@@ -256,7 +256,7 @@ llvm::Value* LowerFunctionLLVM::constant(SEXP co, llvm::Type* needed) {
         eternalConst.count(co))
         return convertToPointer(co, true);
 
-    auto i = Pool::insert(co);
+    auto i = Pool::insert(co, poolRefs);
     llvm::Value* pos = builder.CreateLoad(constantpool);
     pos = builder.CreateBitCast(dataPtr(pos, false),
                                 PointerType::get(t::SEXP, 0));
@@ -509,10 +509,8 @@ llvm::Value* LowerFunctionLLVM::load(Value* val, PirType type,
 llvm::Value* LowerFunctionLLVM::computeAndCheckIndex(Value* index,
                                                      llvm::Value* vector,
                                                      BasicBlock* fallback,
-                                                     llvm::Value* max) {
-    BasicBlock* hit1 = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
-    BasicBlock* hit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
-
+                                                     llvm::Value* max,
+                                                     bool inBounds) {
     auto representation = Representation::Of(index);
     llvm::Value* nativeIndex = load(index);
 
@@ -526,6 +524,15 @@ llvm::Value* LowerFunctionLLVM::computeAndCheckIndex(Value* index,
         }
     }
 
+    // The optimizer proved that 1 <= index <= length(vector)
+    if (inBounds && representation == Representation::Integer) {
+        nativeIndex = builder.CreateZExt(nativeIndex, t::i64);
+        return builder.CreateSub(nativeIndex, c(1ul), "", true, true);
+    }
+
+    BasicBlock* hit1 = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    BasicBlock* hit = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+
     if (representation == Representation::Real) {
         auto indexUnderRange = builder.CreateFCmpULT(nativeIndex, c(1.0));
         auto indexOverRange =
@@ -1586,11 +1593,181 @@ void LowerFunctionLLVM::compileRelop(
     }
 };
 
+void LowerFunctionLLVM::adjustRefcountBeforeUse(Instruction* i) {
+    auto adjustRefcount = refcount.beforeUse.find(i);
+    if (adjustRefcount == refcount.beforeUse.end())
+        return;
+    i->eachArg([&](Value* v) {
+        if (Representation::Of(v) != t::SEXP)
+            return;
+        if (auto j = Instruction::Cast(v->followCasts())) {
+            // Inner nodes of fused expressions do not exist
+            auto fused = fusedVectorExpressions.find(j);
+            if (fused != fusedVectorExpressions.end() &&
+                fused->second->root != j)
+                return;
+            auto needed = adjustRefcount->second.find(j);
+            if (needed != adjustRefcount->second.end()) {
+                auto kind = needed->second;
+                if (kind == NeedsRefcountAdjustment::SetShared)
+                    ensureShared(load(v));
+                else if (kind == NeedsRefcountAdjustment::EnsureNamed)
+                    ensureNamed(load(v));
+            }
+        }
+    });
+}
+
+void LowerFunctionLLVM::compileVectorExpression(
+    const VectorExpressions::Expression& e) {
+    for (auto n : e.nodes)
+        adjustRefcountBeforeUse(n);
+
+    auto toDouble = [&](llvm::Value* v, PirType type) {
+        if (v->getType() == t::Double)
+            return v;
+        auto res = builder.CreateSIToFP(v, t::Double);
+        if (type.maybeNAOrNaN())
+            res = builder.CreateSelect(builder.CreateICmpEQ(v, c(NA_INTEGER)),
+                                       c(NA_REAL), res);
+        return res;
+    };
+
+    // Scalars are loaded once, vectors need to be non-altrep and of the same
+    // length, otherwise R recycles the shorter ones
+    std::unordered_map<Value*, llvm::Value*> scalars;
+    std::unordered_map<Value*, llvm::Value*> vectors;
+    llvm::Value* length = nullptr;
+    llvm::Value* fits = builder.getTrue();
+    for (auto l : e.leaves) {
+        if (l->type.isScalar()) {
+            if (!scalars.count(l)) {
+                auto rep = l->type.isA(RType::real) ? Representation::Real
+                                                    : Representation::Integer;
+                scalars[l] = toDouble(load(l, rep), l->type);
+            }
+        } else if (!vectors.count(l)) {
+            auto v = loadSxp(l);
+            vectors[l] = v;
+            auto len = vectorLength(v);
+            if (!length)
+                length = len;
+            else
+                fits =
+                    builder.CreateAnd(fits, builder.CreateICmpEQ(len, length));
+            fits = builder.CreateAnd(fits, builder.CreateNot(isAltrep(v)));
+        }
+    }
+    assert(length);
+
+    auto fast = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto fallback = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto done = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto res = phiBuilder(t::SEXP);
+    builder.CreateCondBr(fits, fast, fallback, branchMostlyTrue);
+
+    // One loop computing all operations for each element
+    builder.SetInsertPoint(fast);
+    auto vec = call(NativeBuiltins::get(NativeBuiltins::Id::makeVector),
+                    {c(REALSXP), length});
+
+    auto idx = phiBuilder(t::i64);
+    idx.addInput(c(0, 64));
+    auto loopH =
+        BasicBlock::Create(PirJitLLVM::getContext(), "fused-loop-hd", fun);
+    auto loopB = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    auto loopE = BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+    builder.CreateBr(loopH);
+    builder.SetInsertPoint(loopH);
+    auto idxPhi = idx(2);
+    builder.CreateCondBr(builder.CreateICmpEQ(idxPhi, length), loopE, loopB);
+
+    builder.SetInsertPoint(loopB);
+    std::unordered_map<Value*, llvm::Value*> elements(scalars);
+    for (auto& v : vectors)
+        elements[v.first] = toDouble(
+            accessVector(v.second, idxPhi, v.first->type), v.first->type);
+    for (auto n : e.nodes) {
+        auto a = elements.at(n->arg(0).val());
+        auto b = elements.at(n->arg(1).val());
+        switch (n->tag) {
+        case Tag::Add:
+            elements[n] = builder.CreateFAdd(a, b);
+            break;
+        case Tag::Sub:
+            elements[n] = builder.CreateFSub(a, b);
+            break;
+        case Tag::Mul:
+            elements[n] = builder.CreateFMul(a, b);
+            break;
+        case Tag::Div:
+            elements[n] = builder.CreateFDiv(a, b);
+            break;
+        default:
+            assert(false);
+        }
+    }
+    builder.CreateStore(elements.at(e.root),
+                        vectorPositionPtr(vec, idxPhi, e.root->type));
+    idx.addInput(builder.CreateAdd(idxPhi, c(1, 64)));
+    builder.CreateBr(loopH);
+
+    builder.SetInsertPoint(loopE);
+    res.addInput(vec);
+    builder.CreateBr(done);
+
+    // Otherwise we evaluate the operations one by one
+    builder.SetInsertPoint(fallback);
+    std::unordered_map<Value*, llvm::Value*> results;
+    auto arg = [&](Value* v) {
+        auto r = results.find(v);
+        if (r != results.end())
+            return r->second;
+        return loadSxp(v);
+    };
+    for (auto n : e.nodes) {
+        auto kind = BinopKind::ADD;
+        switch (n->tag) {
+        case Tag::Add:
+            break;
+        case Tag::Sub:
+            kind = BinopKind::SUB;
+            break;
+        case Tag::Mul:
+            kind = BinopKind::MUL;
+            break;
+        case Tag::Div:
+            kind = BinopKind::DIV;
+            break;
+        default:
+            assert(false);
+        }
+        auto r = call(NativeBuiltins::get(NativeBuiltins::Id::binop),
+                      {arg(n->arg(0).val()), arg(n->arg(1).val()),
+                       c((int)kind)});
+        if (n != e.root)
+            protectTemp(r);
+        results[n] = r;
+    }
+    res.addInput(results.at(e.root));
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    fusedVectorResult = res();
+}
+
 void LowerFunctionLLVM::compileBinop(
     Instruction* i, Value* lhs, Value* rhs,
     const std::function<llvm::Value*(llvm::Value*, llvm::Value*)>& intInsert,
     const std::function<llvm::Value*(llvm::Value*, llvm::Value*)>& fpInsert,
     BinopKind kind) {
+    // Already computed together with the rest of the expression
+    if (fusedVectorExpressions.count(i)) {
+        assert(fusedVectorExpressions.at(i)->root == i);
+        setVal(i, fusedVectorResult);
+        return;
+    }
+
     auto rep = Representation::Of(i);
     auto lhsRep = Representation::Of(lhs);
     auto rhsRep = Representation::Of(rhs);
@@ -1794,11 +1971,11 @@ bool LowerFunctionLLVM::compileDotcall(
     calli->eachCallArg([&](Value* v) {
         if (auto exp = ExpandDots::Cast(v)) {
             args.push_back(exp);
-            newNames.push_back(Pool::insert(R_DotsSymbol));
+            newNames.push_back(Pool::insert(R_DotsSymbol, poolRefs));
             seenDots = true;
         } else {
             assert(!DotsList::Cast(v));
-            newNames.push_back(Pool::insert(names(pos)));
+            newNames.push_back(Pool::insert(names(pos), poolRefs));
             args.push_back(v);
         }
         pos++;
@@ -2075,7 +2252,7 @@ void LowerFunctionLLVM::compile() {
 
             if (varName) {
                 auto e = MkEnv::Cast(i->env());
-                if (e && !e->stub) {
+                if (e && !e->stub && !e->checkedStub) {
                     bindings.insert(std::pair<Value*, SEXP>(i->env(), varName));
                 }
             }
@@ -2179,6 +2356,14 @@ void LowerFunctionLLVM::compile() {
         });
     }
 
+    // Vector expressions whose operations are next to each other are computed
+    // in one loop, see compileVectorExpression
+    for (auto& e : vectorExpressions) {
+        if (e.contiguous())
+            for (auto n : e.nodes)
+                fusedVectorExpressions[n] = &e;
+    }
+
     std::unordered_map<BB*, int> blockInPushContext;
     blockInPushContext[code->entry] = 0;
 
@@ -2237,23 +2422,17 @@ void LowerFunctionLLVM::compile() {
                 }
             }
 
-            auto adjustRefcount = refcount.beforeUse.find(i);
-            if (adjustRefcount != refcount.beforeUse.end()) {
-                i->eachArg([&](Value* v) {
-                    if (Representation::Of(v) != t::SEXP)
-                        return;
-                    if (auto j = Instruction::Cast(v->followCasts())) {
-                        auto needed = adjustRefcount->second.find(j);
-                        if (needed != adjustRefcount->second.end()) {
-                            auto kind = needed->second;
-                            if (kind == NeedsRefcountAdjustment::SetShared)
-                                ensureShared(load(v));
-                            else if (kind ==
-                                     NeedsRefcountAdjustment::EnsureNamed)
-                                ensureNamed(load(v));
-                        }
-                    }
-                });
+            // The whole expression is computed at its first operation, the
+            // inner nodes are never materialized
+            auto fused = fusedVectorExpressions.find(i);
+            if (fused != fusedVectorExpressions.end()) {
+                auto e = fused->second;
+                if (i == e->nodes.front())
+                    compileVectorExpression(*e);
+                if (i != e->root)
+                    continue;
+            } else {
+                adjustRefcountBeforeUse(i);
             }
 
             switch (i->tag) {
@@ -3310,7 +3489,7 @@ void LowerFunctionLLVM::compile() {
 
                 std::vector<BC::PoolIdx> names;
                 for (size_t i = 0; i < b->names.size(); ++i)
-                    names.push_back(Pool::insert((b->names[i])));
+                    names.push_back(Pool::insert(b->names[i], poolRefs));
                 auto namesConst = c(names);
                 auto namesStore = globalConst(namesConst);
 
@@ -3376,7 +3555,7 @@ void LowerFunctionLLVM::compile() {
                     if (nativeTarget) {
                         assert(
                             asmpt.includes(Assumption::StaticallyArgmatched));
-                        auto idx = Pool::makeSpace();
+                        auto idx = Pool::makeSpace(poolRefs);
                         NativeBuiltins::targetCaches.push_back(idx);
                         Pool::patch(idx, nativeTarget->container());
                         assert(asmpt.smaller(nativeTarget->context()));
@@ -3463,27 +3642,13 @@ void LowerFunctionLLVM::compile() {
             }
 
             case Tag::ScheduledDeopt: {
-                // TODO, this is copied from pir2rir... rather ugly
-                DeoptMetadata* m = nullptr;
-                {
-                    auto deopt = ScheduledDeopt::Cast(i);
-                    size_t nframes = deopt->frames.size();
-                    SEXP store =
-                        Rf_allocVector(RAWSXP, sizeof(DeoptMetadata) +
-                                                   nframes * sizeof(FrameInfo));
-                    m = new (DATAPTR(store)) DeoptMetadata;
-                    m->numFrames = nframes;
-
-                    size_t i = 0;
-                    // Frames in the ScheduledDeopt are in pir argument
-                    // order (from left to right). On the other hand frames
-                    // in the rir deopt_ instruction are in stack order,
-                    // from tos down.
-                    for (auto fi = deopt->frames.rbegin();
-                         fi != deopt->frames.rend(); fi++)
-                        m->frames[i++] = *fi;
-                    Pool::insert(store);
-                }
+                // Frames in the ScheduledDeopt are in pir argument order
+                // (from left to right). On the other hand frames in the deopt
+                // metadata are in stack order, from tos down.
+                auto deopt = ScheduledDeopt::Cast(i);
+                std::vector<FrameInfo> frames(deopt->frames.rbegin(),
+                                              deopt->frames.rend());
+                SEXP m = DeoptMetadata::compress(frames);
 
                 std::vector<Value*> args;
                 i->eachArg([&](Value* v) { args.push_back(v); });
@@ -3491,7 +3656,8 @@ void LowerFunctionLLVM::compile() {
                 withCallFrame(args, [&]() {
                     res = call(NativeBuiltins::get(NativeBuiltins::Id::deopt),
                                {paramCode(), paramClosure(),
-                                convertToPointer(m, t::i8, true), paramArgs()});
+                                convertToPointer(RAW(m), t::i8, true),
+                                paramArgs()});
                     return res;
                 });
                 builder.CreateUnreachable();
@@ -3512,12 +3678,15 @@ void LowerFunctionLLVM::compile() {
                 auto namesConst = c(names);
                 auto namesStore = globalConst(namesConst);
 
-                if (mkenv->stub) {
+                if (mkenv->stub || mkenv->checkedStub) {
+                    auto slots = LazyEnvironmentSlots::create(
+                        names.size(), names.data());
                     auto env =
                         call(NativeBuiltins::get(
                                  NativeBuiltins::Id::createStubEnvironment),
                              {parent, c((int)mkenv->nLocals()),
                               builder.CreateBitCast(namesStore, t::IntPtr),
+                              convertToPointer(DATAPTR(slots), t::i8, true),
                               c(mkenv->context)});
                     protectTemp(env);
                     size_t pos = 0;
@@ -4187,17 +4356,57 @@ void LowerFunctionLLVM::compile() {
                                 res, builder.CreateNot(isObj(a)));
                         }
                     }
+                    if (arg->type.maybeNAOrNaN() &&
+                        !t->typeTest.maybeNAOrNaN()) {
+                        assert(t->typeTest.isScalar());
+                        // Only look at the element if it is a scalar of the
+                        // expected type
+                        auto incoming = builder.GetInsertBlock();
+                        auto checkNa = BasicBlock::Create(
+                            PirJitLLVM::getContext(), "checkNa", fun);
+                        auto done =
+                            BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+                        builder.CreateCondBr(res, checkNa, done);
+
+                        builder.SetInsertPoint(checkNa);
+                        llvm::Value* notNa;
+                        if (t->typeTest.maybe(RType::real)) {
+                            auto v = builder.CreateLoad(builder.CreateBitCast(
+                                dataPtr(a), t::DoublePtr));
+                            notNa = builder.CreateFCmpOEQ(v, v);
+                        } else {
+                            auto v = builder.CreateLoad(
+                                builder.CreateBitCast(dataPtr(a), t::IntPtr));
+                            notNa = builder.CreateICmpNE(v, c(NA_INTEGER));
+                        }
+                        auto checked = builder.GetInsertBlock();
+                        builder.CreateBr(done);
+
+                        builder.SetInsertPoint(done);
+                        auto phi = builder.CreatePHI(t::i1, 2);
+                        phi->addIncoming(res, incoming);
+                        phi->addIncoming(notNa, checked);
+                        res = phi;
+                    }
                     setVal(i, builder.CreateZExt(res, t::Int));
                 } else {
+                    llvm::Value* res = builder.getTrue();
                     if (Representation::Of(arg) == t::Double &&
                         arg->type.maybe(RType::real) &&
                         !t->typeTest.maybe(RType::real)) {
-                        setVal(i, builder.CreateZExt(
-                                      checkDoubleToInt(load(arg), arg->type),
-                                      t::Int));
-                    } else {
-                        setVal(i, c(1));
+                        res = checkDoubleToInt(load(arg), arg->type);
+                    }
+                    if (arg->type.maybeNAOrNaN() &&
+                        !t->typeTest.maybeNAOrNaN()) {
+                        auto v = load(arg);
+                        if (Representation::Of(arg) == t::Double)
+                            res = builder.CreateAnd(res,
+                                                    builder.CreateFCmpOEQ(v, v));
+                        else
+                            res = builder.CreateAnd(
+                                res, builder.CreateICmpNE(v, c(NA_INTEGER)));
                     }
+                    setVal(i, builder.CreateZExt(res, t::Int));
                 }
                 break;
             }
@@ -4478,27 +4687,51 @@ void LowerFunctionLLVM::compile() {
                 if (LdFunctionEnv::Cast(i->env()))
                     env = myPromenv;
 
-                if (env && env->stub) {
+                if (env && (env->stub || env->checkedStub)) {
                     auto e = loadSxp(env);
-                    llvm::Value* res =
-                        envStubGet(e, env->indexOf(varName), env->nLocals());
-                    if (env->argNamed(varName).val() ==
-                        UnboundValue::instance()) {
+                    auto fromStub = [&]() -> llvm::Value* {
+                        // Variables without a slot in the stub, checked or
+                        // not, are looked up starting at its parent
+                        if (!env->contains(varName))
+                            return call(
+                                NativeBuiltins::get(NativeBuiltins::Id::ldvar),
+                                {constant(varName, t::SEXP),
+                                 envStubGet(e, -1, env->nLocals())});
+                        llvm::Value* res = envStubGet(e, env->indexOf(varName),
+                                                      env->nLocals());
+                        if (env->argNamed(varName).val() ==
+                            UnboundValue::instance()) {
 
-                        res = createSelect2(
-                            builder.CreateICmpEQ(
-                                res, constant(R_UnboundValue, t::SEXP)),
-                            // if unsassigned in the stub, fall through
-                            [&]() {
-                                return call(
-                                    NativeBuiltins::get(
-                                        NativeBuiltins::Id::ldvar),
-                                    {constant(varName, t::SEXP),
-                                     envStubGet(e, -1, env->nLocals())});
-                            },
-                            [&]() { return res; });
+                            res = createSelect2(
+                                builder.CreateICmpEQ(
+                                    res, constant(R_UnboundValue, t::SEXP)),
+                                // if unsassigned in the stub, fall through
+                                [&]() {
+                                    return call(
+                                        NativeBuiltins::get(
+                                            NativeBuiltins::Id::ldvar),
+                                        {constant(varName, t::SEXP),
+                                         envStubGet(e, -1, env->nLocals())});
+                                },
+                                [&]() { return res; });
+                        }
+                        return res;
+                    };
+                    if (!env->checkedStub) {
+                        setVal(i, fromStub());
+                        break;
                     }
-                    setVal(i, res);
+                    auto materialized = envStubGet(e, -2, env->nLocals());
+                    auto fromMaterialized = [&]() -> llvm::Value* {
+                        return call(
+                            NativeBuiltins::get(NativeBuiltins::Id::ldvar),
+                            {constant(varName, t::SEXP), materialized});
+                    };
+                    setVal(i, createSelect2(
+                                  builder.CreateICmpEQ(
+                                      materialized,
+                                      llvm::ConstantPointerNull::get(t::SEXP)),
+                                  fromStub, fromMaterialized));
                     break;
                 }
 
@@ -4632,8 +4865,9 @@ void LowerFunctionLLVM::compile() {
                         }
                     }
 
-                    llvm::Value* index =
-                        computeAndCheckIndex(extract->idx(), vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        extract->idx(), vector, fallback, nullptr,
+                        extract->inBounds);
                     auto res0 =
                         extract->vec()->type.isScalar()
                             ? vector
@@ -4778,8 +5012,9 @@ void LowerFunctionLLVM::compile() {
                         builder.SetInsertPoint(hit2);
                     }
 
-                    llvm::Value* index =
-                        computeAndCheckIndex(extract->idx(), vector, fallback);
+                    llvm::Value* index = computeAndCheckIndex(
+                        extract->idx(), vector, fallback, nullptr,
+                        extract->inBounds);
                     auto res0 =
                         extract->vec()->type.isScalar()
                             ? vector
@@ -5302,11 +5537,37 @@ void LowerFunctionLLVM::compile() {
                 if (LdFunctionEnv::Cast(st->env()))
                     environment = myPromenv;
 
-                if (environment && environment->stub) {
+                if (environment &&
+                    (environment->stub || environment->checkedStub)) {
                     auto idx = environment->indexOf(st->varName);
                     auto e = loadSxp(environment);
                     BasicBlock* done =
                         BasicBlock::Create(PirJitLLVM::getContext(), "", fun);
+
+                    if (environment->checkedStub) {
+                        auto isStub = BasicBlock::Create(
+                            PirJitLLVM::getContext(), "", fun);
+                        auto isMaterialized = BasicBlock::Create(
+                            PirJitLLVM::getContext(), "", fun);
+                        auto materialized =
+                            envStubGet(e, -2, environment->nLocals());
+                        builder.CreateCondBr(
+                            builder.CreateICmpEQ(
+                                materialized,
+                                llvm::ConstantPointerNull::get(t::SEXP)),
+                            isStub, isMaterialized, branchMostlyTrue);
+
+                        builder.SetInsertPoint(isMaterialized);
+                        call(NativeBuiltins::get(
+                                 st->isStArg ? NativeBuiltins::Id::starg
+                                             : NativeBuiltins::Id::stvar),
+                             {constant(st->varName, t::SEXP),
+                              loadSxp(st->val()), materialized});
+                        builder.CreateBr(done);
+
+                        builder.SetInsertPoint(isStub);
+                    }
+
                     auto cur = envStubGet(e, idx, environment->nLocals());
 
                     if (Representation::Of(st->val()) != t::SEXP) {
@@ -5495,7 +5756,8 @@ void LowerFunctionLLVM::compile() {
                 auto environment = MkEnv::Cast(st->env());
                 if (environment) {
                     auto parent = MkEnv::Cast(environment->lexicalEnv());
-                    if (environment->stub || (parent && parent->stub)) {
+                    if (environment->stub || environment->checkedStub ||
+                        (parent && (parent->stub || parent->checkedStub))) {
                         call(
                             NativeBuiltins::get(NativeBuiltins::Id::stvarSuper),
                             {constant(st->varName, t::SEXP),
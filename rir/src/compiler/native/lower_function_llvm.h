@@ -4,6 +4,7 @@
 #include "R/Protect.h"
 #include "compiler/analysis/liveness.h"
 #include "compiler/analysis/reference_count.h"
+#include "compiler/analysis/vector_expressions.h"
 #include "compiler/native/builtins.h"
 #include "compiler/native/pir_jit_llvm.h"
 #include "compiler/native/types_llvm.h"
@@ -36,6 +37,10 @@ class LowerFunctionLLVM {
     llvm::IRBuilder<> builder;
     llvm::MDBuilder MDB;
     LivenessIntervals liveness;
+    VectorExpressions vectorExpressions;
+    std::unordered_map<Instruction*, const VectorExpressions::Expression*>
+        fusedVectorExpressions;
+    llvm::Value* fusedVectorResult = nullptr;
     size_t numLocals;
     size_t numTemps;
     size_t maxTemps;
@@ -69,6 +74,9 @@ class LowerFunctionLLVM {
     PirJitLLVM::DebugInfo* DI;
     llvm::DIBuilder* DIB;
 
+    // Constant pool entries the native code of the module refers to
+    Pool::Refs& poolRefs;
+
     Protect p_;
 
   public:
@@ -82,16 +90,18 @@ class LowerFunctionLLVM {
         const std::unordered_set<Instruction*>& needsLdVarForUpdate,
         PirJitLLVM::Declare declare, const PirJitLLVM::GetModule& getModule,
         const PirJitLLVM::GetFunction& getFunction, PirJitLLVM::DebugInfo* DI,
-        llvm::DIBuilder* DIB)
+        llvm::DIBuilder* DIB, Pool::Refs& poolRefs)
         : code(code), promMap(promMap), refcount(refcount),
           needsLdVarForUpdate(needsLdVarForUpdate),
           builder(PirJitLLVM::getContext()), MDB(PirJitLLVM::getContext()),
-          liveness(code, code->nextBBId), numLocals(0), numTemps(0),
-          maxTemps(0), branchAlwaysTrue(MDB.createBranchWeights(100000000, 1)),
+          liveness(code, code->nextBBId), vectorExpressions(code),
+          numLocals(0), numTemps(0), maxTemps(0),
+          branchAlwaysTrue(MDB.createBranchWeights(100000000, 1)),
           branchAlwaysFalse(MDB.createBranchWeights(1, 100000000)),
           branchMostlyTrue(MDB.createBranchWeights(1000, 1)),
           branchMostlyFalse(MDB.createBranchWeights(1, 1000)),
-          getModule(getModule), getFunction(getFunction), DI(DI), DIB(DIB) {
+          getModule(getModule), getFunction(getFunction), DI(DI), DIB(DIB),
+          poolRefs(poolRefs) {
 
         fun = declare(code, name, t::nativeFunction);
 
@@ -394,7 +404,8 @@ class LowerFunctionLLVM {
 
     llvm::Value* computeAndCheckIndex(Value* index, llvm::Value* vector,
                                       llvm::BasicBlock* fallback,
-                                      llvm::Value* max = nullptr);
+                                      llvm::Value* max = nullptr,
+                                      bool inBounds = false);
     bool compileDotcall(Instruction* i,
                         const std::function<llvm::Value*()>& callee,
                         const std::function<SEXP(size_t)>& names);
@@ -402,6 +413,9 @@ class LowerFunctionLLVM {
     void compilePushContext(Instruction* i);
     void compilePopContext(Instruction* i);
 
+    void adjustRefcountBeforeUse(Instruction* i);
+    void compileVectorExpression(const VectorExpressions::Expression& e);
+
     void compileBinop(
         Instruction* i,
         const std::function<llvm::Value*(llvm::Value*, llvm::Value*)>&
@@ -4,8 +4,11 @@
 #include "compiler/native/lower_function_llvm.h"
 #include "compiler/native/pass_schedule_llvm.h"
 #include "compiler/native/types_llvm.h"
+#include "runtime/RuntimeStats.h"
 #include "utils/filesystem.h"
+#include "utils/tracing.h"
 
+#include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
@@ -15,6 +18,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Object/SymbolSize.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -37,6 +41,88 @@ llvm::orc::ThreadSafeContext TSC;
 
 std::string dbgFolder;
 
+// Remembers the size of the functions in every object loaded by the JIT, such
+// that finalizeAndFixup can attribute native code size to rir::Code objects.
+class NativeSizeListener : public llvm::JITEventListener {
+  public:
+    std::unordered_map<uint64_t, uint64_t> sizes;
+
+    void
+    notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile& obj,
+                       const llvm::RuntimeDyld::LoadedObjectInfo& L) override {
+        // The debug object has the sections relocated to their load address
+        auto debugObj = L.getObjectForDebug(obj);
+        if (!debugObj.getBinary())
+            return;
+        for (auto& sym :
+             llvm::object::computeSymbolSizes(*debugObj.getBinary())) {
+            auto type = sym.first.getType();
+            if (!type) {
+                llvm::consumeError(type.takeError());
+                continue;
+            }
+            if (*type != llvm::object::SymbolRef::ST_Function)
+                continue;
+            auto addr = sym.first.getAddress();
+            if (!addr) {
+                llvm::consumeError(addr.takeError());
+                continue;
+            }
+            sizes[*addr] = sym.second;
+        }
+    }
+};
+NativeSizeListener nativeSizes;
+
+// Modules whose rir::Code objects were all collected by the GC. They are
+// released on the next finalizeAndFixup, since finalizers might run in the
+// middle of a JIT operation.
+std::vector<llvm::orc::ResourceTrackerSP> unusedModules;
+
+struct ModuleHandle {
+    llvm::orc::ResourceTrackerSP tracker;
+    Pool::Refs poolRefs;
+};
+
+void moduleUnused(SEXP handle) {
+    auto h = (ModuleHandle*)R_ExternalPtrAddr(handle);
+    if (!h)
+        return;
+    unusedModules.push_back(std::move(h->tracker));
+    Pool::release(h->poolRefs);
+    delete h;
+    R_ClearExternalPtr(handle);
+}
+
+// Accounts the sections allocated for the JIT'd code and data in
+// RuntimeStats, see rir.memoryTotals
+class AccountingMemoryManager : public llvm::SectionMemoryManager {
+    size_t code = 0;
+    size_t data = 0;
+
+  public:
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment,
+                                 unsigned id, llvm::StringRef name) override {
+        code += size;
+        RuntimeStats::llvmAllocated(size, true);
+        return SectionMemoryManager::allocateCodeSection(size, alignment, id,
+                                                         name);
+    }
+
+    uint8_t* allocateDataSection(uintptr_t size, unsigned alignment,
+                                 unsigned id, llvm::StringRef name,
+                                 bool readOnly) override {
+        data += size;
+        RuntimeStats::llvmAllocated(size, false);
+        return SectionMemoryManager::allocateDataSection(size, alignment, id,
+                                                         name, readOnly);
+    }
+
+    ~AccountingMemoryManager() override {
+        RuntimeStats::llvmReleased(code, data);
+    }
+};
+
 } // namespace
 
 void PirJitLLVM::DebugInfo::addCode(Code* c) {
@@ -314,15 +400,42 @@ PirJitLLVM::~PirJitLLVM() {
 }
 
 void PirJitLLVM::finalizeAndFixup() {
+    Tracing::Scope trace("jit", "llvm", name);
     // TODO: maybe later have TSM from the start and use locking
     //       to allow concurrent compilation?
+    for (auto& tracker : unusedModules) {
+        ExitOnErr(tracker->remove());
+        RuntimeStats::nativeModulesReleased++;
+    }
+    unusedModules.clear();
+    // Not before the modules are removed, their code might still use them
+    NativeBuiltins::forgetTargetCaches(Pool::reuseReleased());
+
     auto TSM = llvm::orc::ThreadSafeModule(std::move(M), TSC);
-    ExitOnErr(JIT->addIRModule(std::move(TSM)));
+    auto tracker = JIT->getMainJITDylib().createResourceTracker();
+    ExitOnErr(JIT->addIRModule(tracker, std::move(TSM)));
+
+    // Every Code of this module keeps the handle alive, once they are all
+    // collected the machine code and the pool entries are released
+    SEXP handle = PROTECT(
+        R_MakeExternalPtr(new ModuleHandle{tracker, std::move(poolRefs)},
+                          R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(handle, moduleUnused, FALSE);
+
     for (auto& fix : jitFixup) {
         auto symbol = ExitOnErr(JIT->lookup(fix.second.second));
         void* native = (void*)symbol.getAddress();
         fix.second.first->nativeCode = (NativeCode)native;
+        auto size = nativeSizes.sizes.find(symbol.getAddress());
+        if (size != nativeSizes.sizes.end()) {
+            fix.second.first->nativeCodeSize = size->second;
+            nativeSizes.sizes.erase(size);
+        }
+        fix.second.first->addExtraPoolEntry(handle);
+        if (Tracing::enabled)
+            Tracing::instant("jit", "native install", fix.second.second);
     }
+    UNPROTECT(1);
 }
 
 void PirJitLLVM::compile(
@@ -399,7 +512,7 @@ void PirJitLLVM::compile(
                 return r->second;
             return nullptr;
         },
-        DI.get(), DIB.get());
+        DI.get(), DIB.get(), poolRefs);
 
     llvm::DISubprogram* SP = nullptr;
     if (LLVMDebugInfo()) {
@@ -485,11 +598,12 @@ void PirJitLLVM::initializeLLVM() {
             .setObjectLinkingLayerCreator(
                 [&](ExecutionSession& ES, const Triple& TT) {
                     auto GetMemMgr = []() {
-                        return std::make_unique<SectionMemoryManager>();
+                        return std::make_unique<AccountingMemoryManager>();
                     };
                     auto ObjLinkingLayer =
                         std::make_unique<RTDyldObjectLinkingLayer>(
                             ES, std::move(GetMemMgr));
+                    ObjLinkingLayer->registerJITEventListener(nativeSizes);
 
                     if (LLVMDebugInfo()) {
                         // Register the event debug listeners for gdb and perf.
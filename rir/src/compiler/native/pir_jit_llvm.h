@@ -9,6 +9,7 @@
 #include "compiler/pir/pir.h"
 #include "compiler/pir/promise.h"
 #include "compiler/util/visitor.h"
+#include "utils/Pool.h"
 
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/Function.h"
@@ -89,6 +90,9 @@ class PirJitLLVM {
     std::unordered_map<Code*, std::pair<rir::Code*, std::string>> jitFixup;
     void finalizeAndFixup();
 
+    // Released together with the module
+    Pool::Refs poolRefs;
+
     static size_t nModules;
     static void initializeLLVM();
     static bool initialized;
@@ -59,7 +59,7 @@ void initializeTypes(LLVMContext& context) {
     t::VECTOR_SEXPREC_ptr = PointerType::get(t::VECTOR_SEXPREC, 0);
 
     t::LazyEnvironment = StructType::create(context, "LazyEnvironment");
-    fields = {t::i32, t::i32, t::i32, t::i64, t::voidPtr};
+    fields = {t::i32, t::i32, t::i32, t::i64, t::voidPtr, t::voidPtr};
     t::LazyEnvironment->setBody(fields);
 
     fields = {t::i32, t::i32, t::i32};
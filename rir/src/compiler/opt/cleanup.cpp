@@ -166,14 +166,16 @@ bool Cleanup::apply(Compiler&, ClosureVersion* cls, Code* code,
                         env->replaceUsesWith(Env::elided());
                         removed = true;
                         next = bb->remove(ip);
-                    } else if (bb->isDeopt() && env->stub) {
+                    } else if (bb->isDeopt() &&
+                               (env->stub || env->checkedStub)) {
                         env->stub = false;
+                        env->checkedStub = false;
                     }
                 } else if (auto m = MaterializeEnv::Cast(i)) {
                     if (auto mk = MkEnv::Cast(m->env())) {
                         // We un-stub envs which moved to deopt branches. Thus
                         // we need to also remove the materialize instr.
-                        if (!mk->stub) {
+                        if (!mk->stub && !mk->checkedStub) {
                             i->replaceUsesWith(mk);
                             removed = true;
                             next = bb->remove(ip);
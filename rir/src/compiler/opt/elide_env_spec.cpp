@@ -199,6 +199,10 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
         });
     });
 
+    // Environments which are only banned because of a missing checkpoint can
+    // still be lowered to a stub, if every access checks for materialization
+    auto usageBanned = bannedEnvs;
+
     std::unordered_map<Instruction*,
                        std::unordered_map<Checkpoint*, SmallSet<MkEnv*>>>
         checks;
@@ -230,7 +234,7 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
         }
         if (i->hasEnv()) {
             if (auto st = StVar::Cast(i)) {
-                if (!bannedEnvs.count(i->env())) {
+                if (!usageBanned.count(i->env())) {
                     if (auto mk = MkEnv::Cast(i->env())) {
                         if (!mk->stub && !mk->contains(st->varName)) {
                             additionalEntries[mk].insert(st->varName);
@@ -239,13 +243,14 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
                 }
             }
             if (FrameState::Cast(i) || StVar::Cast(i) || LdVar::Cast(i) ||
-                StVarSuper::Cast(i) || PushContext::Cast(i))
+                StVarSuper::Cast(i) || PushContext::Cast(i) ||
+                MaterializeEnv::Cast(i))
                 return;
             if (auto mk = MkEnv::Cast(i->env())) {
-                if (!mk->stub && !bannedEnvs.count(mk)) {
+                if (!mk->stub && !usageBanned.count(mk)) {
                     if (i->bb()->isDeopt()) {
                         needsMaterialization[mk].insert(i);
-                    } else {
+                    } else if (!bannedEnvs.count(mk)) {
                         // We can only stub an environment if we have a
                         // checkpoint available after every use.
                         if (auto cp = checkpoint.next(i, mk, dom)) {
@@ -267,7 +272,29 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
         }
     });
 
+    // Checked stubs are decided again every time, since the uses might have
+    // changed since the last run
+    Visitor::run(code->entry, [&](Instruction* i) {
+        if (auto mk = MkEnv::Cast(i))
+            mk->checkedStub = false;
+    });
+
     std::unordered_map<BB*, SmallSet<MkEnv*>> materialized;
+    // After eliding an env we must ensure to add a materialization before
+    // every usage in deopt branches
+    auto materializeInDeoptBranches = [&](MkEnv* env) {
+        for (auto mkArg : needsMaterialization[env]) {
+            auto targetBB = mkArg->bb();
+            if (!materialized.count(targetBB) ||
+                !materialized[targetBB].includes(env)) {
+                anyChange = true;
+                Instruction* materialize = new MaterializeEnv(env);
+                env->replaceUsesIn(materialize, targetBB);
+                targetBB->insert(targetBB->begin(), materialize);
+                materialized[targetBB].insert(env);
+            }
+        }
+    };
     VisitorNoDeoptBranch::run(code->entry, [&](BB* bb) {
         auto ip = bb->begin();
         while (ip != bb->end()) {
@@ -290,6 +317,17 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
             }
 
             if (auto env = MkEnv::Cast(i)) {
+                if (!env->stub && bannedEnvs.count(i) &&
+                    !usageBanned.count(i) && !bb->isDeopt() &&
+                    additionalEntries[env].empty()) {
+                    if (debug) {
+                        std::cout << "checked stubbing ";
+                        env->print(std::cout);
+                        std::cout << "\n";
+                    }
+                    env->checkedStub = true;
+                    materializeInDeoptBranches(env);
+                }
                 if (!env->stub && !bannedEnvs.count(i) && !bb->isDeopt()) {
                     if (debug) {
                         std::cout << "stubbing ";
@@ -302,19 +340,7 @@ bool ElideEnvSpec::apply(Compiler&, ClosureVersion* cls, Code* code,
                         env->varName.push_back(n);
                         env->pushArg(UnboundValue::instance(), PirType::any());
                     }
-                    // After eliding an env we must ensure to add a
-                    // materialization before every usage in deopt branches
-                    for (auto mkArg : needsMaterialization[env]) {
-                        auto targetBB = mkArg->bb();
-                        if (!materialized.count(targetBB) ||
-                            !materialized[targetBB].includes(env)) {
-                            anyChange = true;
-                            Instruction* materialize = new MaterializeEnv(env);
-                            env->replaceUsesIn(materialize, targetBB);
-                            targetBB->insert(targetBB->begin(), materialize);
-                            materialized[targetBB].insert(env);
-                        }
-                    }
+                    materializeInDeoptBranches(env);
                 }
             }
 
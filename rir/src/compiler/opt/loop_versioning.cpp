@@ -0,0 +1,301 @@
+#include "../analysis/loop_detection.h"
+#include "../parameter.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "pass_definitions.h"
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+// Collects a chain of single-predecessor blocks starting at bb, which ends in
+// a deopt. Those blocks are only reachable from the loop and need to be
+// duplicated together with it.
+static bool collectDeoptTail(BB* bb, std::unordered_set<BB*>& tail) {
+    while (true) {
+        if (!bb->hasSinglePred())
+            return false;
+        tail.insert(bb);
+        if (bb->isDeopt())
+            return true;
+        if (!bb->isJmp())
+            return false;
+        bb = bb->next();
+    }
+}
+
+// Values flowing out of the loop are merged after the two versions with a
+// phi. We cannot do that for native values (checkpoints, framestates,
+// contexts) or environments.
+static bool canMerge(Value* v) {
+    return v->type.isRType() && !v->type.maybe(RType::env);
+}
+
+namespace {
+
+struct Guard {
+    Assume* assume;
+    Instruction* condition;
+};
+
+struct VersioningCandidate {
+    BB* header = nullptr;
+    BB* preheader = nullptr;
+    std::unordered_set<BB*> region;
+    BB* exitFrom = nullptr;
+    BB* exitTo = nullptr;
+    std::vector<Guard> guards;
+};
+
+} // namespace
+
+static bool findCandidate(Code* code, LoopDetection::Loop& loop,
+                          VersioningCandidate& c) {
+    c.header = loop.header();
+    c.preheader = loop.preheader();
+    if (!c.preheader || !c.preheader->isJmp())
+        return false;
+
+    for (auto bb : loop)
+        c.region.insert(bb);
+
+    size_t size = 0;
+    for (auto bb : loop) {
+        size += bb->size();
+        for (auto s : bb->successors()) {
+            if (c.region.count(s))
+                continue;
+            if (!loop.contains(s) && !s->isMerge()) {
+                std::unordered_set<BB*> tail;
+                if (collectDeoptTail(s, tail)) {
+                    for (auto t : tail)
+                        size += t->size();
+                    c.region.insert(tail.begin(), tail.end());
+                    continue;
+                }
+            }
+            // Only loops with a single exit edge are versioned, for
+            // anything else the merge after the loop gets too complicated.
+            if (c.exitFrom)
+                return false;
+            c.exitFrom = bb;
+            c.exitTo = s;
+        }
+    }
+    if (!c.exitFrom || size > Parameter::LOOP_VERSIONING_MAX_SIZE)
+        return false;
+
+    auto invariant = [&](Value* v) {
+        if (v->type.maybeLazy())
+            return false;
+        if (auto i = Instruction::Cast(v))
+            return !c.region.count(i->bb());
+        return true;
+    };
+
+    for (auto bb : loop) {
+        for (auto i : *bb) {
+            auto assume = Assume::Cast(i);
+            if (!assume)
+                continue;
+            auto cond = Instruction::Cast(assume->condition());
+            if (!cond || !(IsType::Cast(cond) || Identical::Cast(cond)))
+                continue;
+            if (!cond->anyArg([&](Value* a) { return !invariant(a); }))
+                c.guards.push_back({assume, cond});
+        }
+    }
+    if (c.guards.empty())
+        return false;
+
+    // All values defined in the loop and used afterwards need to be merged.
+    bool ok = true;
+    Visitor::run(code->entry, [&](BB* bb) {
+        if (!ok || c.region.count(bb))
+            return;
+        for (auto i : *bb) {
+            i->eachArg([&](Value* a) {
+                if (auto ai = Instruction::Cast(a))
+                    if (c.region.count(ai->bb()) && !canMerge(ai))
+                        ok = false;
+            });
+        }
+    });
+    return ok;
+}
+
+static BB* version(Code* code, VersioningCandidate& c) {
+    std::vector<BB*> outside;
+    Visitor::run(code->entry, [&](BB* bb) {
+        if (!c.region.count(bb))
+            outside.push_back(bb);
+    });
+
+    // 1. Duplicate the loop, the copy will be the optimistic version
+    std::unordered_map<BB*, BB*> bbMap;
+    std::unordered_map<Value*, Value*> valMap;
+    for (auto bb : c.region) {
+        auto copy = BB::cloneInstrs(bb, code->nextBBId++, code);
+        bbMap[bb] = copy;
+        for (size_t i = 0; i < bb->size(); ++i)
+            valMap[bb->at(i)] = copy->at(i);
+    }
+    for (auto bb : c.region) {
+        bbMap.at(bb)->setSuccessors(bb->successors().map([&](BB* s) {
+            return bbMap.count(s) ? bbMap.at(s) : s;
+        }));
+    }
+    for (auto bb : c.region) {
+        for (auto i : *bbMap.at(bb)) {
+            if (auto phi = Phi::Cast(i)) {
+                for (size_t j = 0; j < phi->nargs(); ++j)
+                    if (bbMap.count(phi->inputAt(j)))
+                        phi->updateInputAt(j, bbMap.at(phi->inputAt(j)));
+            }
+            i->eachArg([&](InstrArg& arg) {
+                if (valMap.count(arg.val()))
+                    arg.val() = valMap.at(arg.val());
+            });
+        }
+    }
+    auto optHeader = bbMap.at(c.header);
+
+    // 2. Check all guards once in the preheader and dispatch to one of the two
+    // loops
+    auto pre = c.preheader;
+    auto fallback = new BB(code, code->nextBBId++);
+    fallback->setNext(c.header);
+    pre->deleteSuccessors();
+    for (auto i : *c.header) {
+        if (auto phi = Phi::Cast(i)) {
+            for (size_t j = 0; j < phi->nargs(); ++j)
+                if (phi->inputAt(j) == pre)
+                    phi->updateInputAt(j, fallback);
+        }
+    }
+
+    std::unordered_map<Instruction*, Instruction*> hoisted;
+    for (auto& g : c.guards) {
+        if (hoisted.count(g.condition))
+            continue;
+        if (c.region.count(g.condition->bb())) {
+            auto copy = g.condition->clone();
+            pre->append(copy);
+            hoisted[g.condition] = copy;
+        } else {
+            hoisted[g.condition] = g.condition;
+        }
+    }
+
+    BB* cur = pre;
+    std::set<std::pair<Instruction*, bool>> checked;
+    for (auto& g : c.guards) {
+        if (!checked.insert({g.condition, g.assume->assumeTrue}).second)
+            continue;
+        cur->append(new Branch(hoisted.at(g.condition)));
+        auto fail = new BB(code, code->nextBBId++);
+        fail->setNext(fallback);
+        auto pass = new BB(code, code->nextBBId++);
+        if (g.assume->assumeTrue)
+            cur->setBranch(pass, fail);
+        else
+            cur->setBranch(fail, pass);
+        cur = pass;
+    }
+    cur->setNext(optHeader);
+    for (auto i : *optHeader) {
+        if (auto phi = Phi::Cast(i)) {
+            for (size_t j = 0; j < phi->nargs(); ++j)
+                if (phi->inputAt(j) == pre)
+                    phi->updateInputAt(j, cur);
+        }
+    }
+
+    // 3. Merge the two loop exits
+    auto exitFrom = c.exitFrom;
+    auto optExitFrom = bbMap.at(exitFrom);
+    auto exitTo = c.exitTo;
+    auto merge = new BB(code, code->nextBBId++);
+    auto split1 = new BB(code, code->nextBBId++);
+    auto split2 = new BB(code, code->nextBBId++);
+    exitFrom->replaceSuccessor(exitTo, split1);
+    optExitFrom->replaceSuccessor(exitTo, split2);
+    split1->setNext(merge);
+    split2->setNext(merge);
+    merge->setNext(exitTo);
+    for (auto i : *exitTo) {
+        if (auto phi = Phi::Cast(i)) {
+            for (size_t j = 0; j < phi->nargs(); ++j)
+                if (phi->inputAt(j) == exitFrom)
+                    phi->updateInputAt(j, merge);
+        }
+    }
+
+    std::unordered_map<Value*, Phi*> merged;
+    auto getMerged = [&](Value* v) {
+        if (!merged.count(v)) {
+            auto phi = new Phi;
+            phi->addInput(split1, v);
+            phi->addInput(split2, valMap.at(v));
+            phi->type = v->type;
+            merge->insert(merge->begin(), phi);
+            merged[v] = phi;
+        }
+        return merged.at(v);
+    };
+    for (auto bb : outside) {
+        for (auto i : *bb) {
+            i->eachArg([&](InstrArg& arg) {
+                if (auto ai = Instruction::Cast(arg.val()))
+                    if (c.region.count(ai->bb()))
+                        arg.val() = getMerged(ai);
+            });
+        }
+    }
+
+    // 4. The optimistic version does not need the guards anymore
+    for (auto& g : c.guards) {
+        auto a = Instruction::Cast(valMap.at(g.assume));
+        a->bb()->remove(a);
+    }
+    return optHeader;
+}
+
+bool LoopVersioning::apply(Compiler&, ClosureVersion* cls, Code* code,
+                           LogStream&) const {
+    if (cls->numNonDeoptInstrs() > Parameter::INLINER_MAX_SIZE)
+        return false;
+
+    bool anyChange = false;
+    std::unordered_set<BB*> done;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        LoopDetection loops(code, true);
+        for (auto& loop : loops) {
+            if (!loop.isInnermost() || done.count(loop.header()))
+                continue;
+            done.insert(loop.header());
+
+            VersioningCandidate c;
+            if (!findCandidate(code, loop, c))
+                continue;
+            done.insert(version(code, c));
+            anyChange = changed = true;
+            break;
+        }
+    }
+    return anyChange;
+}
+
+size_t Parameter::LOOP_VERSIONING_MAX_SIZE =
+    getenv("PIR_LOOP_VERSIONING_MAX_SIZE")
+        ? atoi(getenv("PIR_LOOP_VERSIONING_MAX_SIZE"))
+        : 120;
+
+} // namespace pir
+} // namespace rir
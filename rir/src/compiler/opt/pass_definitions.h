@@ -157,11 +157,42 @@ class PASS(InlineForcePromises, false, false);
  */
 class PASS(Overflow, true, false);
 
+/*
+ * Uses induction variables of loops to find vector accesses which are
+ * statically in bounds, e.g. the loop variable of a for loop, and marks them
+ * to skip the index checks. Indexing into seq_len / seq_along with an in
+ * bounds index is replaced by the index itself.
+ */
+class PASS(StrengthReduction, false, false);
+
+/*
+ * Scalar replacement of small vectors created by `c(...)` from scalars. Reads
+ * with a constant index and length are replaced by the elements. If the
+ * vector is then only needed on deopt, the allocation is sunk into the deopt
+ * branches.
+ */
+class PASS(ScalarReplacement, true, false);
+
+/*
+ * Element-wise arithmetic on vectors, e.g. `a * b + c`, is computed by the
+ * native backend in one loop, without the intermediate vectors. This pass
+ * moves the operations of such an expression next to each other, which the
+ * backend needs to fuse them.
+ */
+class PASS(VectorFusion, false, false);
+
 /*
  * Loop Invariant Code motion
  */
 class PASS(HoistInstruction, false, false);
 
+/*
+ * Duplicates small innermost loops which contain assumptions on loop invariant
+ * values. The guards are checked once in the preheader, if they hold we enter
+ * a copy of the loop without the assumptions, otherwise the original loop.
+ */
+class PASS(LoopVersioning, false, false);
+
 class PhaseMarker : public Pass {
   public:
     explicit PhaseMarker(const std::string& name) : Pass(name) {}
@@ -37,6 +37,7 @@ PassScheduler::PassScheduler() {
         add<LoadElision>();
         add<GVN>();
         add<Constantfold>();
+        add<ScalarReplacement>();
         add<DeadStoreRemoval>();
 
         add<Inline>();
@@ -79,6 +80,7 @@ PassScheduler::PassScheduler() {
 
     nextPhase("Speculation post");
     addDefaultPostPhaseOpt();
+    add<LoopVersioning>();
 
     // ==== Phase 3) Remove checkpoints we did not use
     //
@@ -114,8 +116,10 @@ PassScheduler::PassScheduler() {
 
     nextPhase("Final post");
     addDefaultPostPhaseOpt();
+    add<StrengthReduction>();
     add<Cleanup>();
     add<CleanupCheckpoints>();
+    add<VectorFusion>();
 
     nextPhase("done");
 }
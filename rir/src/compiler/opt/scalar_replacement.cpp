@@ -0,0 +1,138 @@
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "R/BuiltinIds.h"
+#include "R/r.h"
+#include "compiler/analysis/cfg.h"
+#include "pass_definitions.h"
+
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+// c(a, b, ...) where all arguments are scalars of the same type without
+// attributes. The result is a plain vector with exactly the arguments as
+// elements.
+static bool isSmallVector(Instruction* i) {
+    auto c = CallSafeBuiltin::Cast(i);
+    if (!c || c->builtinId != blt("c") || c->nCallArgs() == 0)
+        return false;
+    for (auto t : {RType::integer, RType::real, RType::logical, RType::str}) {
+        auto scalar = PirType(t).simpleScalar();
+        bool all = true;
+        c->eachCallArg([&](Value* v) {
+            if (!v->type.isA(scalar))
+                all = false;
+        });
+        if (all)
+            return true;
+    }
+    return false;
+}
+
+// Returns the (0-based) position of a constant index, or -1
+static int constantIndex(Value* idx, size_t length) {
+    auto ld = LdConst::Cast(idx);
+    if (!ld)
+        return -1;
+    double pos = -1;
+    if (IS_SIMPLE_SCALAR(ld->c(), INTSXP)) {
+        if (INTEGER(ld->c())[0] != NA_INTEGER)
+            pos = INTEGER(ld->c())[0];
+    } else if (IS_SIMPLE_SCALAR(ld->c(), REALSXP)) {
+        pos = REAL(ld->c())[0];
+    }
+    if (pos < 1 || pos > length || pos != (size_t)pos)
+        return -1;
+    return (size_t)pos - 1;
+}
+
+bool ScalarReplacement::apply(Compiler&, ClosureVersion*, Code* code,
+                              LogStream&) const {
+    bool anyChange = false;
+    std::unordered_set<Instruction*> candidates;
+
+    // 1. Reads from small vectors with a constant index are replaced by the
+    // element itself
+    Visitor::run(code->entry, [&](BB* bb) {
+        auto ip = bb->begin();
+        while (ip != bb->end()) {
+            auto next = ip + 1;
+            auto i = *ip;
+
+            Value* vec = nullptr;
+            Value* idx = nullptr;
+            if (auto e = Extract1_1D::Cast(i)) {
+                vec = e->vec();
+                idx = e->idx();
+            } else if (auto e = Extract2_1D::Cast(i)) {
+                vec = e->vec();
+                idx = e->idx();
+            } else if (auto l = Length::Cast(i)) {
+                vec = l->arg(0).val();
+            }
+
+            auto alloc = vec ? Instruction::Cast(vec->followCasts()) : nullptr;
+            if (alloc && isSmallVector(alloc)) {
+                auto c = CallSafeBuiltin::Cast(alloc);
+                candidates.insert(alloc);
+                if (Length::Cast(i)) {
+                    i->replaceUsesAndSwapWith(new LdConst((int)c->nCallArgs()),
+                                              ip);
+                    anyChange = true;
+                } else {
+                    auto pos = constantIndex(idx, c->nCallArgs());
+                    if (pos != -1) {
+                        auto elem = c->callArg(pos).val();
+                        if (elem->type.isA(i->type)) {
+                            i->replaceUsesWith(elem);
+                            next = bb->remove(ip);
+                            anyChange = true;
+                        }
+                    }
+                }
+            }
+
+            ip = next;
+        }
+    });
+
+    if (candidates.empty())
+        return anyChange;
+
+    // 2. Escape analysis: if the vector is now only needed to reconstruct the
+    // interpreter state on deopt, we sink the allocation into the deopt
+    // branches. Anything else makes the vector escape and it stays.
+    UsesTree uses(code);
+    for (auto alloc : candidates) {
+        if (alloc->bb()->isDeopt())
+            continue;
+        auto& allocUses = uses.at(alloc);
+        bool escapes = false;
+        std::unordered_set<BB*> deopts;
+        for (auto use : allocUses) {
+            if (Phi::Cast(use) || !use->bb()->isDeopt())
+                escapes = true;
+            else
+                deopts.insert(use->bb());
+        }
+        if (escapes)
+            continue;
+
+        for (auto target : deopts) {
+            auto pos = target->begin();
+            while (!allocUses.includes(*pos))
+                pos++;
+            auto copy = alloc->clone();
+            target->insert(pos, copy);
+            alloc->replaceUsesIn(copy, target);
+        }
+        alloc->bb()->remove(alloc);
+        anyChange = true;
+    }
+
+    return anyChange;
+}
+
+} // namespace pir
+} // namespace rir
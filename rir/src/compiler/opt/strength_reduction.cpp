@@ -0,0 +1,188 @@
+#include "../analysis/induction_variables.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "R/BuiltinIds.h"
+#include "compiler/analysis/cfg.h"
+#include "pass_definitions.h"
+
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+// Calls to seq_len and seq_along produce the integer vector 1..n
+static bool isSequence(Value* v) {
+    if (auto b = CallBuiltin::Cast(v))
+        return b->builtinId == blt("seq_len") ||
+               b->builtinId == blt("seq_along");
+    if (auto b = CallSafeBuiltin::Cast(v))
+        return b->builtinId == blt("seq_len") ||
+               b->builtinId == blt("seq_along");
+    return false;
+}
+
+static Value* seqAlongArg(Value* v) {
+    if (auto b = CallBuiltin::Cast(v))
+        if (b->builtinId == blt("seq_along") && b->nCallArgs() == 1)
+            return b->callArg(0).val()->followCastsAndForce();
+    if (auto b = CallSafeBuiltin::Cast(v))
+        if (b->builtinId == blt("seq_along") && b->nCallArgs() == 1)
+            return b->callArg(0).val()->followCastsAndForce();
+    return nullptr;
+}
+
+namespace {
+
+// In all blocks dominated by `from`, we know that `idx <= length(vec)`
+struct UpperBound {
+    BB* from;
+    Value* idx;
+    Value* vec;
+};
+
+} // namespace
+
+static void findUpperBounds(Code* code, std::vector<UpperBound>& bounds) {
+    Visitor::run(code->entry, [&](BB* bb) {
+        if (!bb->isBranch() || !Branch::Cast(bb->last()))
+            return;
+        auto cond = bb->last()->arg(0).val();
+        if (auto t = CheckTrueFalse::Cast(cond))
+            cond = t->arg(0).val();
+        auto cmp = Instruction::Cast(cond);
+        if (!cmp || cmp->effects.contains(Effect::ExecuteCode))
+            return;
+
+        Value* len = nullptr;
+        Value* idx = nullptr;
+        BB* holds = nullptr;
+        switch (cmp->tag) {
+        case Tag::Lt: // len < idx is false
+            len = cmp->arg(0).val();
+            idx = cmp->arg(1).val();
+            holds = bb->falseBranch();
+            break;
+        case Tag::Gt: // idx > len is false
+            idx = cmp->arg(0).val();
+            len = cmp->arg(1).val();
+            holds = bb->falseBranch();
+            break;
+        case Tag::Lte: // idx <= len is true
+            idx = cmp->arg(0).val();
+            len = cmp->arg(1).val();
+            holds = bb->trueBranch();
+            break;
+        case Tag::Gte: // len >= idx is true
+            len = cmp->arg(0).val();
+            idx = cmp->arg(1).val();
+            holds = bb->trueBranch();
+            break;
+        default:
+            return;
+        }
+        if (!holds->hasSinglePred())
+            return;
+
+        auto intScalar = PirType(RType::integer).simpleScalar();
+        if (!len->type.isA(intScalar) || !idx->type.isA(intScalar))
+            return;
+
+        Value* vec = nullptr;
+        if (auto sz = ForSeqSize::Cast(len))
+            vec = sz->arg(0).val()->followCastsAndForce();
+        else if (auto sz = Length::Cast(len))
+            vec = sz->arg(0).val()->followCastsAndForce();
+        if (!vec)
+            return;
+
+        bounds.push_back({holds, idx, vec});
+        // length(seq_along(x)) == length(x), unless length dispatches
+        if (auto x = seqAlongArg(vec))
+            if (!x->type.maybeObj())
+                bounds.push_back({holds, idx, x});
+    });
+}
+
+bool StrengthReduction::apply(Compiler&, ClosureVersion*, Code* code,
+                              LogStream&) const {
+    std::vector<UpperBound> bounds;
+    findUpperBounds(code, bounds);
+    if (bounds.empty())
+        return false;
+
+    InductionVariables ivs(code);
+    DominanceGraph dom(code);
+
+    // idx1 <= idx2 holds if both are the same induction variable with a
+    // smaller offset
+    auto notGreater = [&](Value* idx1, Value* idx2) {
+        if (idx1 == idx2)
+            return true;
+        InductionVariables::InductionVariable iv1, iv2;
+        return ivs.get(idx1, iv1) && ivs.get(idx2, iv2) &&
+               iv1.base == iv2.base && iv1.offset <= iv2.offset;
+    };
+
+    auto inBounds = [&](Instruction* i, Value* vec, Value* idx) {
+        int lb;
+        if (!ivs.lowerBound(idx, lb) || lb < 1)
+            return false;
+        vec = vec->followCastsAndForce();
+        for (auto& b : bounds) {
+            if (b.vec == vec && notGreater(idx, b.idx) &&
+                dom.dominates(b.from, i->bb()))
+                return true;
+        }
+        return false;
+    };
+
+    bool anyChange = false;
+    Visitor::run(code->entry, [&](BB* bb) {
+        auto ip = bb->begin();
+        while (ip != bb->end()) {
+            auto next = ip + 1;
+            auto i = *ip;
+
+            Value* vec = nullptr;
+            Value* idx = nullptr;
+            if (auto e = Extract1_1D::Cast(i)) {
+                vec = e->vec();
+                idx = e->idx();
+                if (!e->inBounds && inBounds(e, vec, idx)) {
+                    e->inBounds = true;
+                    anyChange = true;
+                }
+                if (!e->inBounds)
+                    vec = nullptr;
+            } else if (auto e = Extract2_1D::Cast(i)) {
+                vec = e->vec();
+                idx = e->idx();
+                if (!e->inBounds && inBounds(e, vec, idx)) {
+                    e->inBounds = true;
+                    anyChange = true;
+                }
+                if (!e->inBounds)
+                    vec = nullptr;
+            }
+
+            // seq_len(n)[[i]] == i, this turns the loop variable of
+            // `for (i in seq_len(n))` into the loop counter
+            if (vec && isSequence(vec->followCastsAndForce()) &&
+                !i->effects.contains(Effect::ExecuteCode) &&
+                idx->type.isA(i->type)) {
+                i->replaceUsesWith(idx);
+                if (!i->hasObservableEffects()) {
+                    next = bb->remove(ip);
+                }
+                anyChange = true;
+            }
+
+            ip = next;
+        }
+    });
+
+    return anyChange;
+}
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,53 @@
+#include "../analysis/vector_expressions.h"
+#include "../pir/pir_impl.h"
+#include "pass_definitions.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+bool VectorFusion::apply(Compiler&, ClosureVersion*, Code* code,
+                         LogStream&) const {
+    bool anyChange = false;
+    VectorExpressions exprs(code);
+
+    for (auto& e : exprs) {
+        if (e.contiguous())
+            continue;
+
+        // The nodes are moved down, right before the root. This is only
+        // possible if we do not reorder them with other effects.
+        auto bb = e.root->bb();
+        std::unordered_set<Instruction*> members(e.nodes.begin(),
+                                                 e.nodes.end());
+        auto first = bb->size();
+        for (auto n : e.nodes)
+            first = std::min(first, (size_t)bb->indexOf(n));
+        bool ok = true;
+        for (auto i = first; i < bb->indexOf(e.root); ++i) {
+            auto other = bb->at(i);
+            if (!members.count(other) && other->hasStrongEffects())
+                ok = false;
+        }
+        if (!ok)
+            continue;
+
+        auto target = e.root;
+        for (auto n = e.nodes.rbegin() + 1; n != e.nodes.rend(); ++n) {
+            auto it = bb->begin() + bb->indexOf(*n);
+            while (*(it + 1) != target) {
+                bb->swapWithNext(it);
+                ++it;
+            }
+            target = *n;
+        }
+        anyChange = true;
+    }
+
+    return anyChange;
+}
+
+} // namespace pir
+} // namespace rir
@@ -13,6 +13,13 @@ struct Parameter {
     static size_t MAX_INPUT_SIZE;
     static unsigned RIR_WARMUP;
     static unsigned DEOPT_ABANDON;
+    static unsigned DEOPT_STORM_WINDOW;
+    static unsigned DEOPT_BLACKLIST;
+    static unsigned RIR_FEEDBACK_SPLITS;
+    static unsigned RIR_FEEDBACK_DECAY;
+    static size_t RIR_CODE_CACHE_BUDGET;
+    static unsigned MATERIALIZE_HASHED_ARITY;
+    static unsigned PROMISE_FREE_LIST;
 
     static size_t PROMISE_INLINER_MAX_SIZE;
 
@@ -21,6 +28,8 @@ struct Parameter {
     static size_t INLINER_INITIAL_FUEL;
     static size_t INLINER_INLINE_UNLIKELY;
 
+    static size_t LOOP_VERSIONING_MAX_SIZE;
+
     static bool RIR_PRESERVE;
     static unsigned RIR_SERIALIZE_CHAOS;
 
@@ -129,7 +129,7 @@ Builder::Builder(ClosureVersion* version, Value* closureEnv)
     }
 
     auto mkenv = new MkEnv(closureEnv, closure->formals().names(), args.data());
-    auto rirCode = version->owner()->rirFunction()->body();
+    auto rirCode = version->rirSrc();
     if (rirCode->flags.contains(rir::Code::NeedsFullEnv))
         mkenv->neverStub = true;
     mkenv->typeFeedback.srcCode = rirCode;
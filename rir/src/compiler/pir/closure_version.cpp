@@ -128,6 +128,14 @@ ClosureVersion::ClosureVersion(Closure* closure, rir::Function* optFunction,
     id.str("");
     id << this;
     nameSuffix_ = id.str();
+
+    // Use the feedback which was collected for calls in this context, if the
+    // baseline was split
+    auto fun = closure->rirFunction();
+    if (auto split = fun->feedbackSplit(optimizationContext))
+        rirSrc_ = split->body();
+    else
+        rirSrc_ = fun->body();
 }
 
 std::ostream& operator<<(std::ostream& out, const ClosureVersion::Property& p) {
@@ -163,9 +171,7 @@ std::ostream& operator<<(std::ostream& out,
     return out;
 }
 
-rir::Code* ClosureVersion::rirSrc() const {
-    return owner()->rirFunction()->body();
-}
+rir::Code* ClosureVersion::rirSrc() const { return rirSrc_; }
 
 } // namespace pir
 } // namespace rir
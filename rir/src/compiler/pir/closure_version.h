@@ -48,6 +48,7 @@ class ClosureVersion
     Closure* owner_;
     std::vector<Promise*> promises_;
     const Context& optimizationContext_;
+    rir::Code* rirSrc_;
 
     std::string name_;
     std::string nameSuffix_;
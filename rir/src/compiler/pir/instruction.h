@@ -1549,6 +1549,9 @@ class FLIE(Extract1_1D, 3, Effects::Any()) {
     Value* vec() const { return arg(0).val(); }
     Value* idx() const { return arg(1).val(); }
 
+    // Set if the index is statically known to be within 1..length(vec)
+    bool inBounds = false;
+
     PirType inferType(const GetType& getType) const override final;
     Effects inferEffects(const GetType& getType) const override final {
         return ifNonObjectArgs(getType, effects & errorWarnVisible, effects);
@@ -1569,6 +1572,9 @@ class FLIE(Extract2_1D, 3, Effects::Any()) {
     Value* vec() const { return arg(0).val(); }
     Value* idx() const { return arg(1).val(); }
 
+    // Set if the index is statically known to be within 1..length(vec)
+    bool inBounds = false;
+
     PirType inferType(const GetType& getType) const override final {
         return ifNonObjectArgs(
             getType, type & getType(vec()).extractType(getType(idx())), type);
@@ -2336,6 +2342,9 @@ class VLIE(MkEnv, Effect::LeakArg) {
     std::vector<bool> missing;
     bool stub = false;
     bool neverStub = false;
+    // Not a stub for the optimizer, but lowered to one. Since it might be
+    // materialized without deopting, every access checks for that.
+    bool checkedStub = false;
     int context = 1;
 
     typedef std::function<void(SEXP name, Value* val, bool missing)> LocalVarIt;
@@ -182,7 +182,9 @@ void PirType::merge(const ObservedValues& other) {
         flags_.set(TypeFlags::maybeNotFastVecelt);
     assert(other.attribs || (!other.notFastVecelt && !other.object));
 
-    flags_.set(TypeFlags::maybeNAOrNaN);
+    // Only scalars can be cheaply checked for NA by a type test
+    if (other.maybeNA || other.notScalar)
+        flags_.set(TypeFlags::maybeNAOrNaN);
     for (size_t i = 0; i < other.numTypes; ++i)
         merge(other.seen[i]);
 
@@ -7,6 +7,7 @@
 #include "compiler/analysis/query.h"
 #include "compiler/analysis/verifier.h"
 #include "compiler/opt/pass_definitions.h"
+#include "compiler/parameter.h"
 #include "compiler/pir/builder.h"
 #include "compiler/pir/pir_impl.h"
 #include "compiler/util/arg_match.h"
@@ -401,6 +402,7 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
 
     case Opcode::stvar_:
     case Opcode::stvar_cached_:
+    case Opcode::stvar_loop_:
         if (bc.immediateConst() == symbol::c)
             compiler.seenC = true;
         forceIfPromised(0);
@@ -517,6 +519,10 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
     }
 
     case Opcode::record_type_: {
+        // Typechecks at this location keep failing, stop speculating
+        if (bc.immediate.typeFeedback.numDeopts >=
+            Parameter::DEOPT_BLACKLIST)
+            break;
         if (bc.immediate.typeFeedback.numTypes) {
             auto feedback = bc.immediate.typeFeedback;
             if (auto i = Instruction::Cast(at(0))) {
@@ -1218,7 +1224,7 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
 } // namespace pir
 
 bool Rir2Pir::tryCompile(Builder& insert) {
-    return tryCompile(cls->owner()->rirFunction()->body(), insert);
+    return tryCompile(cls->rirSrc(), insert);
 }
 
 bool Rir2Pir::tryCompile(rir::Code* srcCode, Builder& insert) {
@@ -1474,7 +1480,7 @@ Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) {
                 }
             }
             inner << "@";
-            if (srcCode != cls->owner()->rirFunction()->body()) {
+            if (srcCode != cls->rirSrc()) {
                 size_t i = 0;
                 for (auto c : insert.function->promises()) {
                     if (c == insert.code) {
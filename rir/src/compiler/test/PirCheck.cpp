@@ -1,5 +1,7 @@
 #include "PirCheck.h"
 #include "../../ir/Compiler.h"
+#include "../analysis/loop_detection.h"
+#include "../analysis/vector_expressions.h"
 #include "../analysis/query.h"
 #include "../analysis/verifier.h"
 #include "../pir/pir_impl.h"
@@ -243,6 +245,65 @@ static bool testAnAddIsNotNAOrNaN(ClosureVersion* f) {
     return success;
 }
 
+// A loop which still checks its assumptions and a copy of it without, as
+// produced by LoopVersioning
+static bool testVersionedLoop(ClosureVersion* f) {
+    bool guarded = false;
+    bool unguarded = false;
+    LoopDetection loops(f);
+    for (auto& loop : loops) {
+        bool assumes = false;
+        for (auto bb : loop)
+            for (auto i : *bb)
+                if (Assume::Cast(i))
+                    assumes = true;
+        if (assumes)
+            guarded = true;
+        else
+            unguarded = true;
+    }
+    return guarded && unguarded;
+}
+
+// An extract without range checks, see StrengthReduction
+static bool testInBoundsExtract(ClosureVersion* f) {
+    bool success = false;
+    Visitor::run(f->entry, [&](Instruction* i) {
+        if (auto e = Extract1_1D::Cast(i))
+            success = success || e->inBounds;
+        if (auto e = Extract2_1D::Cast(i))
+            success = success || e->inBounds;
+    });
+    return success;
+}
+
+static bool testNoExtract(ClosureVersion* f) {
+    return Visitor::check(f->entry, [&](Instruction* i) {
+        return !Extract1_1D::Cast(i) && !Extract2_1D::Cast(i);
+    });
+}
+
+// An environment that is only materialized if a callee reflects on it, see
+// ElideEnvSpec
+static bool testCheckedStubEnv(ClosureVersion* f) {
+    bool success = false;
+    Visitor::run(f->entry, [&](Instruction* i) {
+        if (auto mk = MkEnv::Cast(i))
+            success = success || mk->checkedStub;
+    });
+    return success;
+}
+
+// Element-wise arithmetic of several operations that the backend computes in
+// one loop, see VectorFusion
+static bool testFusedVectorExpression(ClosureVersion* f) {
+    VectorExpressions exprs(f);
+    for (auto& e : exprs)
+        if (e.nodes.size() > 1 && e.contiguous())
+            return true;
+    return false;
+}
+
 PirCheck::Type PirCheck::parseType(const char* str) {
 #define V(Check)                                                               \
     if (strcmp(str, #Check) == 0)                                              \
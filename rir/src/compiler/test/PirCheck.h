@@ -30,7 +30,12 @@ namespace rir {
     V(EagerCallArgs)                                                           \
     V(LdVarVectorInFirstBB)                                                    \
     V(UnboxedExtract)                                                          \
-    V(AnAddIsNotNAOrNaN)
+    V(AnAddIsNotNAOrNaN)                                                       \
+    V(VersionedLoop)                                                           \
+    V(InBoundsExtract)                                                         \
+    V(NoExtract)                                                               \
+    V(CheckedStubEnv)                                                          \
+    V(FusedVectorExpression)
 
 struct PirCheck {
     enum class Type : unsigned {
@@ -424,7 +424,7 @@ class CachePosition {
     unsigned globalEnvsCacheSize() const { return globalEnvsCacheSize_; }
 
     void ifCacheRange(MkEnv* env, std::function<void(StartSize)> apply) const {
-        if (!env->stub && envCacheRanges.count(env))
+        if (!env->stub && !env->checkedStub && envCacheRanges.count(env))
             apply(envCacheRanges.at(env));
     }
 
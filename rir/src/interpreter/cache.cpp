@@ -0,0 +1,154 @@
+#include "cache.h"
+
+namespace rir {
+
+namespace {
+
+// Longest chain of frames from the start of a cached lookup to the frame with
+// the binding, e.g. namespace, imports and base namespace
+constexpr size_t MaxChain = 4;
+
+struct Entry {
+    SEXP sym;
+    // A binding cell in a locked frame, or the env to continue the lookup in
+    SEXP binding;
+    // The frames the lookup went through, starting at the env it started in.
+    // All but the global and base envs are locked, thus only their parents
+    // can change.
+    SEXP chain[MaxChain];
+    size_t chainLength;
+    bool fun;
+};
+
+constexpr size_t CacheSize = 4096;
+Entry cache[CacheSize];
+
+// Keeps the frames of the cached lookups alive, and with them the binding
+// cells. Entries are released when they are overwritten.
+SEXP roots = nullptr;
+
+} // namespace
+
+static size_t slotOf(SEXP sym, SEXP start, bool fun) {
+    auto h = ((uintptr_t)sym >> 4) * 31 + ((uintptr_t)start >> 4) + fun;
+    return (h ^ (h >> 12)) & (CacheSize - 1);
+}
+
+static bool isFunction(SEXP v) {
+    return TYPEOF(v) == CLOSXP || TYPEOF(v) == BUILTINSXP ||
+           TYPEOF(v) == SPECIALSXP;
+}
+
+static bool findBinding(SEXP sym, SEXP start, bool fun, Entry& e) {
+    e.chainLength = 0;
+    for (SEXP rho = start; rho != R_EmptyEnv; rho = ENCLOS(rho)) {
+        if (e.chainLength == MaxChain)
+            return false;
+        e.chain[e.chainLength++] = rho;
+        if (rho == R_GlobalEnv || rho == R_BaseEnv || rho == R_BaseNamespace) {
+            e.binding = rho;
+            return true;
+        }
+        if (TYPEOF(rho) != ENVSXP || OBJECT(rho) || !FRAME_IS_LOCKED(rho))
+            return false;
+        auto loc = R_findVarLocInFrame(rho, sym);
+        if (R_VARLOC_IS_NULL(loc))
+            continue;
+        if (IS_ACTIVE_BINDING(loc.cell))
+            return false;
+        if (fun) {
+            // Rf_findFun would skip this binding
+            SEXP v = CAR(loc.cell);
+            if (TYPEOF(v) == PROMSXP)
+                v = PRVALUE(v);
+            if (v != R_UnboundValue && !isFunction(v))
+                return false;
+        }
+        e.binding = loc.cell;
+        return true;
+    }
+    return false;
+}
+
+// Locked frames can't gain or lose bindings, but parent.env<- can still
+// change where the lookup continues
+static bool chainUnchanged(const Entry& e) {
+    for (size_t i = 1; i < e.chainLength; ++i)
+        if (ENCLOS(e.chain[i - 1]) != e.chain[i])
+            return false;
+    return true;
+}
+
+static SEXP lookup(SEXP sym, SEXP start, bool fun) {
+    auto slot = slotOf(sym, start, fun);
+    auto& e = cache[slot];
+    if (e.sym == sym && e.chainLength && e.chain[0] == start && e.fun == fun &&
+        chainUnchanged(e)) {
+        RuntimeStats::globalBindingCacheHits++;
+    } else {
+        Entry found;
+        if (!findBinding(sym, start, fun, found)) {
+            RuntimeStats::globalBindingCacheUncacheable++;
+            return fun ? Rf_findFun(sym, start) : Rf_findVar(sym, start);
+        }
+        RuntimeStats::globalBindingCacheMisses++;
+        found.sym = sym;
+        found.fun = fun;
+
+        if (!roots) {
+            roots = Rf_allocVector(VECSXP, CacheSize * MaxChain);
+            R_PreserveObject(roots);
+        }
+        for (size_t i = 0; i < MaxChain; ++i)
+            SET_VECTOR_ELT(roots, slot * MaxChain + i,
+                           i < found.chainLength ? found.chain[i]
+                                                 : R_NilValue);
+        e = found;
+    }
+
+    if (TYPEOF(e.binding) == ENVSXP)
+        return fun ? Rf_findFun(sym, e.binding) : Rf_findVar(sym, e.binding);
+
+    SEXP v = CAR(e.binding);
+    if (!fun)
+        return v;
+    if (TYPEOF(v) == PROMSXP) {
+        PROTECT(v);
+        v = Rf_eval(v, start);
+        UNPROTECT(1);
+    }
+    if (isFunction(v))
+        return v;
+    return Rf_findFun(sym, start);
+}
+
+static bool uncached(SEXP sym, SEXP env) {
+    return DDVAL(sym) || TYPEOF(env) != ENVSXP || env == R_GlobalEnv ||
+           env == R_BaseEnv || env == R_BaseNamespace || env == R_EmptyEnv;
+}
+
+SEXP cachedFindVar(SEXP sym, SEXP env) {
+    if (uncached(sym, env))
+        return Rf_findVar(sym, env);
+    if (FRAME_IS_LOCKED(env))
+        return lookup(sym, env, false);
+
+    // The local frame is usually new in every invocation
+    SEXP v = Rf_findVarInFrame3(env, sym, TRUE);
+    if (v != R_UnboundValue)
+        return v;
+    return lookup(sym, ENCLOS(env), false);
+}
+
+SEXP cachedFindFun(SEXP sym, SEXP env) {
+    if (uncached(sym, env))
+        return Rf_findFun(sym, env);
+    if (FRAME_IS_LOCKED(env))
+        return lookup(sym, env, true);
+
+    if (Rf_findVarInFrame3(env, sym, FALSE) != R_UnboundValue)
+        return Rf_findFun(sym, env);
+    return lookup(sym, ENCLOS(env), true);
+}
+
+} // namespace rir
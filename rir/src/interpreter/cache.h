@@ -3,6 +3,7 @@
 
 #include "R/r.h"
 #include "instance.h"
+#include "runtime/RuntimeStats.h"
 #include <type_traits>
 
 namespace rir {
@@ -179,6 +180,7 @@ static RIR_INLINE SEXP getCellFromCache(SEXP env, Immediate poolIdx,
     if (env != R_BaseEnv && env != R_BaseNamespace) {
         SEXP cell = cachedGetBindingCell(cacheIdx, cache);
         if (!cell) {
+            RuntimeStats::bindingCacheMisses++;
             SEXP sym = cp_pool_at(ctx, poolIdx);
             SLOWASSERT(TYPEOF(sym) == SYMSXP);
             R_varloc_t loc = R_findVarLocInFrame(env, sym);
@@ -187,6 +189,7 @@ static RIR_INLINE SEXP getCellFromCache(SEXP env, Immediate poolIdx,
                 return loc.cell;
             }
         } else {
+            RuntimeStats::bindingCacheHits++;
             return cell;
         }
     }
@@ -262,5 +265,18 @@ static inline void rirSetVarWrapper(SEXP sym, SEXP val, SEXP env) {
 }
 
 #endif
+
+/*
+ * Rf_findVar and Rf_findFun, but the part of the lookup after the local frame
+ * is remembered across invocations. It is cached when it only walks locked
+ * frames, e.g. namespaces and their imports, and ends in the global env, in
+ * base or in a binding of one of the locked frames. Locked frames cannot gain
+ * or lose bindings, so a remembered binding cell stays valid and the value is
+ * read from it. Everything from the global env on is left to R's global cache,
+ * which is flushed on assign, rm and attach.
+ */
+SEXP cachedFindVar(SEXP sym, SEXP env);
+SEXP cachedFindFun(SEXP sym, SEXP env);
+
 } // namespace rir
 #endif
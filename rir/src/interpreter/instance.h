@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <functional>
 #include <stdint.h>
+#include <vector>
 
 #include "runtime/Function.h"
 
@@ -58,6 +59,8 @@ typedef struct {
 struct InterpreterInstance {
     SEXP list;
     ResizeableList cp;
+    // Constant pool entries released by collected native code
+    std::vector<unsigned> cpFreeList;
     ResizeableList src;
     ExprCompiler exprCompiler;
     ClosureCompiler closureCompiler;
@@ -183,6 +186,12 @@ InterpreterInstance* context_create();
 #define src_pool_length(c) (rl_length(&(c)->src))
 
 RIR_INLINE size_t cp_pool_add(InterpreterInstance* c, SEXP v) {
+    if (!c->cpFreeList.empty()) {
+        size_t result = c->cpFreeList.back();
+        c->cpFreeList.pop_back();
+        SET_VECTOR_ELT(c->cp.list, result, v);
+        return result;
+    }
     size_t result = rl_length(&c->cp);
     rl_append(&c->cp, v, c->list, CONTEXT_INDEX_CP);
     return result;
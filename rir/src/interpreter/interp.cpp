@@ -8,10 +8,12 @@
 #include "ir/Deoptimization.h"
 #include "runtime/LazyArglist.h"
 #include "runtime/LazyEnvironment.h"
+#include "runtime/RuntimeStats.h"
 #include "runtime/TypeFeedback_inl.h"
 #include "safe_force.h"
 #include "utils/Pool.h"
 #include "utils/measuring.h"
+#include "utils/tracing.h"
 
 #include <assert.h>
 #include <deque>
@@ -25,6 +27,7 @@
 
 extern "C" {
 extern SEXP Rf_NewEnvironment(SEXP, SEXP, SEXP);
+extern SEXP R_NewHashedEnv(SEXP, SEXP);
 extern Rboolean R_Visible;
 }
 
@@ -170,8 +173,54 @@ static void endClosureContext(RCNTXT* cntxt, SEXP result) {
 SEXP evalRirCode(Code*, InterpreterInstance*, SEXP, const CallContext*, Opcode*,
                  BindingCache*);
 
+// Promises the interpreter passed to a builtin are dead once the builtin
+// returns, since builtins only ever see the forced values. They are kept on
+// this free list and reused for the next promises the interpreter creates.
+// The list is preserved, thus the promises on it survive a GC.
+static SEXP promiseFreeList = nullptr;
+static size_t promiseFreeListLength = 0;
+
+static RIR_INLINE SEXP newPromise(SEXP code, SEXP env) {
+    if (promiseFreeListLength == 0)
+        return Rf_mkPROMISE(code, env);
+
+    SEXP p = VECTOR_ELT(promiseFreeList, --promiseFreeListLength);
+    SET_VECTOR_ELT(promiseFreeList, promiseFreeListLength, R_NilValue);
+    ENSURE_NAMEDMAX(code);
+    SET_PRCODE(p, code);
+    SET_PRENV(p, env);
+    SET_PRSEEN(p, 0);
+    RuntimeStats::promisesRecycled++;
+    return p;
+}
+
+// Only called after a builtin returned, for calls whose stack arguments come
+// straight from mk_promise_ and mk_eager_promise_, i.e. are not referenced
+// from anywhere else.
+static void recycleArgPromises(const CallContext& call, SEXP res) {
+    size_t capacity = pir::Parameter::PROMISE_FREE_LIST;
+    if (capacity == 0)
+        return;
+    if (!promiseFreeList) {
+        promiseFreeList = Rf_allocVector(VECSXP, capacity);
+        R_PreserveObject(promiseFreeList);
+    }
+
+    for (size_t i = 0;
+         i < call.suppliedArgs && promiseFreeListLength < capacity; ++i) {
+        SEXP p = call.stackArg(i);
+        // A cleared PRCODE means it is already on the free list
+        if (TYPEOF(p) != PROMSXP || p == res || PRCODE(p) == R_NilValue)
+            continue;
+        SET_PRVALUE(p, R_UnboundValue);
+        SET_PRENV(p, R_NilValue);
+        SET_PRCODE(p, R_NilValue);
+        SET_VECTOR_ELT(promiseFreeList, promiseFreeListLength++, p);
+    }
+}
+
 static RIR_INLINE SEXP createPromise(Code* code, SEXP env) {
-    SEXP p = Rf_mkPROMISE(code->container(), env);
+    SEXP p = newPromise(code->container(), env);
     return p;
 }
 
@@ -281,8 +330,17 @@ SEXP materialize(SEXP wrapper) {
         assert(!lazyEnv->materialized());
 
         PROTECT(wrapper);
-        SEXP arglist = R_NilValue;
         auto names = lazyEnv->names;
+        auto hashedArity = pir::Parameter::MATERIALIZE_HASHED_ARITY;
+        auto hashed = hashedArity && lazyEnv->nargs >= hashedArity;
+        if (hashed) {
+            // Lookups in large frames would walk the whole pairlist
+            PROTECT(res = R_NewHashedEnv(lazyEnv->getParent(),
+                                         Rf_ScalarInteger(lazyEnv->nargs)));
+        } else {
+            PROTECT(res = R_NilValue);
+        }
+        SEXP arglist = R_NilValue;
         for (size_t i = 0; i < lazyEnv->nargs; ++i) {
             SEXP val = lazyEnv->getArg(i);
             if (val == R_UnboundValue)
@@ -290,15 +348,22 @@ SEXP materialize(SEXP wrapper) {
             SEXP name = cp_pool_at(globalContext(), names[i]);
             if (TYPEOF(name) == LISTSXP)
                 name = CAR(name);
-            // cons protects its args if needed
-            arglist = CONS_NR(val, arglist);
-            SET_TAG(arglist, name);
+            if (hashed) {
+                Rf_defineVar(name, val, res);
+                arglist = R_findVarLocInFrame(res, name).cell;
+            } else {
+                // cons protects its args if needed
+                arglist = CONS_NR(val, arglist);
+                SET_TAG(arglist, name);
+            }
             if (val == R_MissingArg)
                 SET_MISSING(arglist, 1);
             else if (lazyEnv->missing[i])
                 SET_MISSING(arglist, 2);
         }
-        res = Rf_NewEnvironment(R_NilValue, arglist, lazyEnv->getParent());
+        if (!hashed)
+            res = Rf_NewEnvironment(R_NilValue, arglist, lazyEnv->getParent());
+        UNPROTECT(1);
         lazyEnv->materialized(res);
         Rf_setAttrib(res, symbol::delayedEnv, wrapper);
         lazyEnv->clear();
@@ -564,8 +629,17 @@ void checkUserInterrupt() {
     }
 }
 
+bool MEASURE_DEOPTS = getenv("PIR_MEASURE_DEOPTS") ? true : false;
+
+Opcode* lastDeoptOrigin = nullptr;
+
 void recordDeoptReason(SEXP val, const DeoptReason& reason) {
     Opcode* pos = (Opcode*)reason.srcCode + reason.originOffset;
+    lastDeoptOrigin = pos;
+    RuntimeStats::deopts[reason.reason]++;
+    if (Tracing::enabled)
+        Tracing::instant("deopt", RuntimeStats::deoptReasonNames[reason.reason],
+                         std::to_string(reason.originOffset));
     switch (reason.reason) {
     case DeoptReason::DeadBranchReached: {
         assert(*pos == Opcode::record_test_);
@@ -577,6 +651,11 @@ void recordDeoptReason(SEXP val, const DeoptReason& reason) {
         assert(*pos == Opcode::record_type_);
         ObservedValues* feedback = (ObservedValues*)(pos + 1);
         feedback->record(val);
+        if (feedback->numDeopts < UINT8_MAX)
+            feedback->numDeopts++;
+        if (MEASURE_DEOPTS &&
+            feedback->numDeopts == pir::Parameter::DEOPT_BLACKLIST)
+            Measuring::countEvent("deopt site blacklisted");
         if (TYPEOF(val) == PROMSXP) {
             if (PRVALUE(val) == R_UnboundValue &&
                 feedback->stateBeforeLastForce < ObservedValues::promise)
@@ -729,9 +808,10 @@ static SEXP closureArgumentAdaptor(const CallContext& call, SEXP arglist) {
            assignments arguments increment REFCNT values */
         ENABLE_REFCNT(a);
 
-        Code* c = fun->defaultArg(pos++);
+        auto argPos = pos++;
         if (CAR(f) != R_MissingArg) {
             if (CAR(a) == R_MissingArg) {
+                Code* c = fun->defaultArg(argPos);
                 assert(c != nullptr && "No more compiled formals available.");
                 SETCAR(a, createPromise(c, newrho));
                 SET_MISSING(a, 2);
@@ -954,6 +1034,20 @@ unsigned pir::Parameter::RIR_WARMUP =
     getenv("PIR_WARMUP") ? atoi(getenv("PIR_WARMUP")) : 3;
 unsigned pir::Parameter::DEOPT_ABANDON =
     getenv("PIR_DEOPT_ABANDON") ? atoi(getenv("PIR_DEOPT_ABANDON")) : 10;
+unsigned pir::Parameter::DEOPT_STORM_WINDOW =
+    getenv("PIR_DEOPT_STORM_WINDOW") ? atoi(getenv("PIR_DEOPT_STORM_WINDOW"))
+                                     : 100;
+unsigned pir::Parameter::DEOPT_BLACKLIST =
+    getenv("PIR_DEOPT_BLACKLIST") ? atoi(getenv("PIR_DEOPT_BLACKLIST")) : 4;
+unsigned pir::Parameter::MATERIALIZE_HASHED_ARITY =
+    getenv("PIR_MATERIALIZE_HASHED")
+        ? atoi(getenv("PIR_MATERIALIZE_HASHED"))
+        : 24;
+unsigned pir::Parameter::PROMISE_FREE_LIST =
+    getenv("PIR_PROMISE_FREE_LIST") ? atoi(getenv("PIR_PROMISE_FREE_LIST"))
+                                    : 64;
+unsigned pir::Parameter::RIR_FEEDBACK_DECAY =
+    getenv("PIR_FEEDBACK_DECAY") ? atoi(getenv("PIR_FEEDBACK_DECAY")) : 0;
 
 static unsigned serializeCounter = 0;
 
@@ -1066,6 +1160,12 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
     Function* fun = dispatch(call, table);
     fun->registerInvocation();
 
+    // Periodically age the feedback of the baseline, such that a long running
+    // program is eventually optimized for its current behavior
+    if (pir::Parameter::RIR_FEEDBACK_DECAY && fun == table->baseline() &&
+        fun->invocationCount() % pir::Parameter::RIR_FEEDBACK_DECAY == 0)
+        fun->decayFeedback();
+
     if (!isDeoptimizing() && RecompileHeuristic(table, fun)) {
         Context given = call.givenContext;
         // addDynamicAssumptionForOneTarget compares arguments with the
@@ -1082,6 +1182,15 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
             }
         }
     }
+
+    // Calls with different argument types record into separate copies of the
+    // baseline, such that each optimized version sees its own feedback
+    if (fun == table->baseline()) {
+        if (auto split = fun->feedbackSplit(call.givenContext, true)) {
+            split->registerInvocation();
+            fun = split;
+        }
+    }
     bool needsEnv = fun->signature().envCreation ==
                     FunctionSignature::Environment::CallerProvided;
 
@@ -1593,6 +1702,54 @@ bool isMissing(SEXP symbol, SEXP environment, Code* code, Opcode* pc) {
 // terrible, can't find out where in the evalRirCode function
 #pragma GCC diagnostic ignored "-Wstrict-overflow"
 
+/*
+ * Finds the function contexts of all frames of a deopt in one walk over the
+ * context stack. Inlinees only have a context if they were inlined with one,
+ * which is then more recent than the context of the outermost frame, thus the
+ * walk stops there. Looking up every frame separately would walk the whole
+ * context stack for each inlinee without context.
+ */
+static void findDeoptFrameContexts(InterpreterInstance* ctx,
+                                   DeoptMetadata* deoptData,
+                                   size_t stackHeight, RCNTXT** contexts) {
+    auto n = deoptData->numFrames;
+    auto envs = (SEXP*)alloca(n * sizeof(SEXP));
+    size_t missing = 0;
+    for (size_t pos = n; pos-- > 0;) {
+        auto& f = deoptData->frames[pos];
+        stackHeight -= f.stackSize + 1;
+        contexts[pos] = nullptr;
+        envs[pos] = nullptr;
+        if (f.inPromise)
+            continue;
+        envs[pos] = ostack_at(ctx, stackHeight);
+        if (auto le = LazyEnvironment::check(envs[pos]))
+            if (le->materialized())
+                envs[pos] = le->materialized();
+        missing++;
+    }
+
+    auto outermost = envs[n - 1];
+    for (auto cptr = (RCNTXT*)R_GlobalContext;
+         missing && cptr->nextcontext != NULL; cptr = cptr->nextcontext) {
+        if (!(cptr->callflag & CTXT_FUNCTION))
+            continue;
+        for (size_t pos = 0; pos < n; ++pos) {
+            if (envs[pos] && !contexts[pos] && cptr->cloenv == envs[pos]) {
+                contexts[pos] = cptr;
+                missing--;
+            }
+        }
+        if (cptr->cloenv == outermost)
+            break;
+    }
+}
+
+static void deoptFrames(InterpreterInstance* ctx, const CallContext* callCtxt,
+                        DeoptMetadata* deoptData, SEXP sysparent, size_t pos,
+                        size_t stackHeight, RCNTXT* currentContext,
+                        RCNTXT** frameContexts);
+
 /*
  * This function takes some deopt metadata and stack frame contents on the
  * interpreter stack. It first recursively reconstructs a context for each
@@ -1607,6 +1764,19 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
                             DeoptMetadata* deoptData, SEXP sysparent,
                             size_t pos, size_t stackHeight,
                             RCNTXT* currentContext) {
+    assert(pos == deoptData->numFrames - 1);
+    // Not on the heap, since we long-jump out of the deopt
+    auto frameContexts =
+        (RCNTXT**)alloca(deoptData->numFrames * sizeof(RCNTXT*));
+    findDeoptFrameContexts(ctx, deoptData, stackHeight, frameContexts);
+    deoptFrames(ctx, callCtxt, deoptData, sysparent, pos, stackHeight,
+                currentContext, frameContexts);
+}
+
+static void deoptFrames(InterpreterInstance* ctx, const CallContext* callCtxt,
+                        DeoptMetadata* deoptData, SEXP sysparent, size_t pos,
+                        size_t stackHeight, RCNTXT* currentContext,
+                        RCNTXT** frameContexts) {
     size_t excessStack = stackHeight;
 
     const FrameInfo& f = deoptData->frames[pos];
@@ -1632,7 +1802,8 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
     if (inPromise) {
         cntxt = currentContext;
     } else {
-        RCNTXT* originalCntxt = findFunctionContextFor(deoptEnv);
+        RCNTXT* originalCntxt = frameContexts[pos];
+        SLOWASSERT(originalCntxt == findFunctionContextFor(deoptEnv));
         if (originalCntxt) {
             cntxt = originalCntxt;
         } else {
@@ -1687,8 +1858,8 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
 
         // 2. Execute the inner frames
         if (!innermostFrame) {
-            deoptFramesWithContext(ctx, callCtxt, deoptData, deoptEnv, pos - 1,
-                                   stackHeight, cntxt);
+            deoptFrames(ctx, callCtxt, deoptData, deoptEnv, pos - 1,
+                        stackHeight, cntxt, frameContexts);
         }
 
         // 3. Execute our frame
@@ -1980,6 +2151,11 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
     // some intermediate values on the stack
     ostack_ensureSize(ctx, c->stackLength + 5);
 
+    // Frames resumed by a deopt have their stack rebuilt from values of the
+    // native code, we do not know that the promises there are unshared. Loop
+    // trampolines resume the frame they are part of and pass its cache.
+    bool recyclePromises = !initialPC || cache;
+
     Opcode* pc;
 
     if (initialPC) {
@@ -2035,7 +2211,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(ldfun_) {
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
-            res = Rf_findFun(sym, env);
+            res = cachedFindFun(sym, env);
 
             // TODO something should happen here
             if (res == R_UnboundValue)
@@ -2146,7 +2322,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
             assert(!LazyEnvironment::check(env));
-            res = Rf_findVar(sym, env);
+            res = cachedFindVar(sym, env);
             R_Visible = TRUE;
 
             recordForceBehavior(res);
@@ -2172,7 +2348,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
             assert(!LazyEnvironment::check(env));
-            res = Rf_findVar(sym, env);
+            res = cachedFindVar(sym, env);
             R_Visible = TRUE;
 
             if (res == R_UnboundValue) {
@@ -2301,6 +2477,44 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             NEXT();
         }
 
+        INSTRUCTION(stvar_loop_) {
+            Immediate id = readImmediate();
+            advanceImmediate();
+            Immediate cacheIndex = readImmediate();
+            advanceImmediate();
+            SEXP val = ostack_pop(ctx);
+
+            assert(!LazyEnvironment::check(env));
+
+            // The scalar bound by the previous iteration is only referenced
+            // by the binding, if nobody copied the index variable. The value
+            // on the stack then stays unreferenced and the increment of the
+            // loop counter can reuse it too.
+            SEXP loc = getCellFromCache(env, id, cacheIndex, ctx, bindingCache);
+            if (loc && !BINDING_IS_LOCKED(loc) && !IS_ACTIVE_BINDING(loc)) {
+                SEXP cur = CAR(loc);
+                if (cur != val && !MAYBE_SHARED(cur) && !ALTREP(cur)) {
+                    if (IS_SIMPLE_SCALAR(val, INTSXP) &&
+                        IS_SIMPLE_SCALAR(cur, INTSXP)) {
+                        updateScalar(cur, *INTEGER(val));
+                        SET_MISSING(loc, 0);
+                        RuntimeStats::loopVarsUpdatedInPlace++;
+                        NEXT();
+                    }
+                    if (IS_SIMPLE_SCALAR(val, REALSXP) &&
+                        IS_SIMPLE_SCALAR(cur, REALSXP)) {
+                        updateScalar(cur, *REAL(val));
+                        SET_MISSING(loc, 0);
+                        RuntimeStats::loopVarsUpdatedInPlace++;
+                        NEXT();
+                    }
+                }
+            }
+
+            cachedSetVar(val, env, id, cacheIndex, ctx, bindingCache);
+            NEXT();
+        }
+
         INSTRUCTION(stvar_super_) {
             SEXP sym = readConst(ctx, readImmediate());
             advanceImmediate();
@@ -2359,6 +2573,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                              n, ast, ostack_cell_at(ctx, (long)n - 1), env,
                              R_NilValue, given, ctx);
             res = doCall(call, ctx);
+            if (recyclePromises && call.hasEagerCallee())
+                recycleArgPromises(call, res);
             ostack_popn(ctx, call.passedArgs + 1);
             ostack_push(ctx, res);
 
@@ -2386,6 +2602,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                              n, ast, ostack_cell_at(ctx, (long)n - 1), names,
                              env, R_NilValue, given, ctx);
             res = doCall(call, ctx);
+            if (recyclePromises && call.hasEagerCallee())
+                recycleArgPromises(call, res);
             ostack_popn(ctx, call.passedArgs + 1);
             ostack_push(ctx, res);
 
@@ -2496,7 +2714,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(mk_eager_promise_) {
             Immediate id = readImmediate();
             advanceImmediate();
-            SEXP prom = Rf_mkPROMISE(c->getPromise(id)->container(), env);
+            SEXP prom = newPromise(c->getPromise(id)->container(), env);
             SEXP val = ostack_pop(ctx);
             assert(TYPEOF(val) != PROMSXP);
             ENSURE_NAMEDMAX(val);
@@ -2508,7 +2726,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(mk_promise_) {
             Immediate id = readImmediate();
             advanceImmediate();
-            SEXP prom = Rf_mkPROMISE(c->getPromise(id)->container(), env);
+            SEXP prom = newPromise(c->getPromise(id)->container(), env);
             ostack_push(ctx, prom);
             NEXT();
         }
@@ -66,7 +66,8 @@ inline bool RecompileHeuristic(DispatchTable* table, Function* fun,
               ((fun != table->baseline() && fun->invocationCount() >= 2 &&
                 fun->invocationCount() <= pir::Parameter::RIR_WARMUP) ||
                (fun->invocationCount() %
-                (factor * (pir::Parameter::RIR_WARMUP))) == 0))));
+                ((factor << table->recompileBackoff()) *
+                 (pir::Parameter::RIR_WARMUP))) == 0))));
 }
 
 inline bool RecompileCondition(DispatchTable* table, Function* fun,
@@ -120,7 +121,10 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
                             DeoptMetadata* deoptData, SEXP sysparent,
                             size_t pos, size_t stackHeight,
                             RCNTXT* currentContext);
+extern bool MEASURE_DEOPTS;
 void recordDeoptReason(SEXP val, const DeoptReason& reason);
+// The record_ instruction updated by the last recordDeoptReason
+extern Opcode* lastDeoptOrigin;
 void jit(SEXP cls, SEXP name, InterpreterInstance* ctx);
 
 SEXP seq_int(int n1, int n2);
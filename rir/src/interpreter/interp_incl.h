@@ -51,6 +51,10 @@ void serializeRir(SEXP s, SEXP refTable, R_outpstream_t out);
 SEXP deserializeRir(SEXP refTable, R_inpstream_t inp);
 // Will serialize and deserialize the SEXP, returning a deep copy.
 SEXP copyBySerial(SEXP x);
+// Deserializes a file written by R_SaveToFile from a temporary read-only
+// mapping of it, instead of reading it into a buffer. The result is a regular
+// copy in the R heap.
+SEXP loadMappedFile(const char* path);
 
 SEXP materialize(SEXP rirDataWrapper);
 
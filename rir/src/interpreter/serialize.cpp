@@ -3,6 +3,12 @@
 #include "runtime/DispatchTable.h"
 #include <R/r.h>
 
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace rir {
 
 bool pir::Parameter::RIR_PRESERVE =
@@ -12,6 +18,10 @@ unsigned pir::Parameter::RIR_SERIALIZE_CHAOS =
 
 static bool oldPreserve = false;
 
+// Written before every rir object, bump it whenever the serialized layout of
+// DispatchTable, Function or Code changes. 2: Function has feedback splits.
+static constexpr unsigned RIR_SERIALIZE_VERSION = 2;
+
 // Will serialize s if it's an instance of CLS
 template <typename CLS>
 static bool trySerialize(SEXP s, SEXP refTable, R_outpstream_t out) {
@@ -27,6 +37,7 @@ static bool trySerialize(SEXP s, SEXP refTable, R_outpstream_t out) {
 void serializeRir(SEXP s, SEXP refTable, R_outpstream_t out) {
     if (pir::Parameter::RIR_PRESERVE) {
         OutInteger(out, EXTERNALSXP);
+        OutInteger(out, RIR_SERIALIZE_VERSION);
         if (!trySerialize<DispatchTable>(s, refTable, out) &&
             !trySerialize<Code>(s, refTable, out) &&
             !trySerialize<Function>(s, refTable, out)) {
@@ -40,6 +51,10 @@ void serializeRir(SEXP s, SEXP refTable, R_outpstream_t out) {
 }
 
 SEXP deserializeRir(SEXP refTable, R_inpstream_t inp) {
+    unsigned version = InInteger(inp);
+    if (version != RIR_SERIALIZE_VERSION)
+        Rf_error("can't deserialize rir code of version %u, expected %u",
+                 version, RIR_SERIALIZE_VERSION);
     unsigned code = InInteger(inp);
     switch (code) {
     case DISPATCH_TABLE_MAGIC:
@@ -70,4 +85,70 @@ SEXP copyBySerial(SEXP x) {
     return copy;
 }
 
+namespace {
+struct MappedInput {
+    const char* path;
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+};
+} // namespace
+
+static int mappedInChar(R_inpstream_t stream) {
+    auto in = (MappedInput*)stream->data;
+    if (in->pos >= in->size)
+        Rf_error("unexpected end of file %s", in->path);
+    return (unsigned char)in->data[in->pos++];
+}
+
+static void mappedInBytes(R_inpstream_t stream, void* buf, int length) {
+    auto in = (MappedInput*)stream->data;
+    if (in->pos + length > in->size)
+        Rf_error("unexpected end of file %s", in->path);
+    memcpy(buf, in->data + in->pos, length);
+    in->pos += length;
+}
+
+static SEXP unserializeMapped(void* data) {
+    auto in = (MappedInput*)data;
+    // The magic number written by R_SaveToFile, e.g. "RDX3\n"
+    if (in->size < 5 || strncmp(in->data, "RDX", 3) != 0 ||
+        in->data[4] != '\n')
+        Rf_error("%s is not a serialized R object", in->path);
+    in->pos = 5;
+    struct R_inpstream_st stream;
+    R_InitInPStream(&stream, in, R_pstream_any_format, mappedInChar,
+                    mappedInBytes, nullptr, R_NilValue);
+    return R_Unserialize(&stream);
+}
+
+static void unmap(void* data) {
+    auto in = (MappedInput*)data;
+    munmap((void*)in->data, in->size);
+}
+
+// Only saves reading the file into a buffer. R_Unserialize copies everything
+// into the R heap and the mapping is gone once this returns, so nothing stays
+// shared between processes loading the same file.
+SEXP loadMappedFile(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        Rf_error("couldn't open file at path");
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        Rf_error("couldn't read file at path");
+    }
+    MappedInput in;
+    in.path = path;
+    in.size = st.st_size;
+    void* data = mmap(nullptr, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        Rf_error("couldn't map file at path");
+    in.data = (const char*)data;
+    madvise(data, in.size, MADV_SEQUENTIAL);
+    return R_ExecWithCleanup(unserializeMapped, &in, unmap, &in);
+}
+
 }; // namespace rir
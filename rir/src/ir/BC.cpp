@@ -58,6 +58,7 @@ void BC::write(CodeStream& cs) const {
     case Opcode::ldvar_cached_:
     case Opcode::ldvar_for_update_cache_:
     case Opcode::stvar_cached_:
+    case Opcode::stvar_loop_:
         cs.insert(immediate.poolAndCache);
         return;
 
@@ -109,7 +110,8 @@ void BC::write(CodeStream& cs) const {
 }
 
 SEXP BC::immediateConst() const {
-    if (is(Opcode::ldvar_cached_) || is(Opcode::stvar_cached_))
+    if (is(Opcode::ldvar_cached_) || is(Opcode::stvar_cached_) ||
+        is(Opcode::stvar_loop_))
         return Pool::get(immediate.poolAndCache.poolIndex);
     else
         return Pool::get(immediate.pool);
@@ -146,6 +148,7 @@ void BC::deserialize(SEXP refTable, R_inpstream_t inp, Opcode* code,
         case Opcode::ldvar_cached_:
         case Opcode::ldvar_for_update_cache_:
         case Opcode::stvar_cached_:
+        case Opcode::stvar_loop_:
             i.poolAndCache.poolIndex = Pool::insert(ReadItem(refTable, inp));
             i.poolAndCache.cacheIndex = InInteger(inp);
             break;
@@ -242,6 +245,7 @@ void BC::serialize(SEXP refTable, R_outpstream_t out, const Opcode* code,
         case Opcode::ldvar_cached_:
         case Opcode::ldvar_for_update_cache_:
         case Opcode::stvar_cached_:
+        case Opcode::stvar_loop_:
             WriteItem(Pool::get(i.poolAndCache.poolIndex), refTable, out);
             OutInteger(out, i.poolAndCache.cacheIndex);
             break;
@@ -388,6 +392,7 @@ void BC::print(std::ostream& out) const {
     case Opcode::ldvar_cached_:
     case Opcode::ldvar_for_update_cache_:
     case Opcode::stvar_cached_:
+    case Opcode::stvar_loop_:
         out << CHAR(PRINTNAME(immediateConst())) << "{"
             << immediate.poolAndCache.cacheIndex << "}";
         break;
@@ -162,6 +162,14 @@ BC BC::stvarCached(SEXP sym, uint32_t cacheSlot) {
     i.poolAndCache.cacheIndex = cacheSlot;
     return BC(Opcode::stvar_cached_, i);
 }
+BC BC::stvarLoop(SEXP sym, uint32_t cacheSlot) {
+    assert(TYPEOF(sym) == SYMSXP);
+    assert(strlen(CHAR(PRINTNAME(sym))));
+    ImmediateArguments i;
+    i.poolAndCache.poolIndex = Pool::insert(sym);
+    i.poolAndCache.cacheIndex = cacheSlot;
+    return BC(Opcode::stvar_loop_, i);
+}
 BC BC::stvarSuper(SEXP sym) {
     assert(TYPEOF(sym) == SYMSXP);
     assert(strlen(CHAR(PRINTNAME(sym))));
@@ -336,6 +336,7 @@ BC_NOARGS(V, _)
     inline static BC mkEagerPromise(FunIdx prom);
     inline static BC stvar(SEXP sym);
     inline static BC stvarCached(SEXP sym, uint32_t cacheSlot);
+    inline static BC stvarLoop(SEXP sym, uint32_t cacheSlot);
     inline static BC stvarSuper(SEXP sym);
     inline static BC missing(SEXP sym);
     inline static BC beginloop(Jmp);
@@ -565,6 +566,7 @@ BC_NOARGS(V, _)
         case Opcode::ldvar_cached_:
         case Opcode::ldvar_for_update_cache_:
         case Opcode::stvar_cached_:
+        case Opcode::stvar_loop_:
             memcpy(&immediate.poolAndCache, pc,
                    sizeof(PoolAndCachePositionRange));
             break;
@@ -604,7 +606,7 @@ BC_NOARGS(V, _)
             break;
         case Opcode::record_test_:
             memcpy(reinterpret_cast<void*>(&immediate.testFeedback), pc,
-                   sizeof(ObservedValues));
+                   sizeof(ObservedTest));
             break;
         case Opcode::record_type_:
             memcpy(reinterpret_cast<void*>(&immediate.typeFeedback), pc,
@@ -18,7 +18,7 @@ class CodeStream {
     friend class Compiler;
 
     std::vector<char>* code;
-    std::vector<Code*> promises;
+    std::vector<SEXP> promises;
 
     typedef unsigned PcOffset;
     PcOffset pos = 0;
@@ -51,8 +51,12 @@ class CodeStream {
     CodeStream(const CodeStream& other) = delete;
     CodeStream& operator=(const CodeStream& other) = delete;
 
-    size_t addPromise(Code* code) {
-        preserve(code->container());
+    size_t addPromise(Code* code) { return addPromise(code->container()); }
+
+    // Either the code of the promise, or its AST if the compilation is
+    // deferred to the first use
+    size_t addPromise(SEXP code) {
+        preserve(code);
         auto s = promises.size();
         promises.push_back(code);
         return s;
@@ -151,7 +155,7 @@ class CodeStream {
         assert(res->extraPoolSize == 0 &&
                "promise indices and src pool idx need to be aligned");
         for (auto c : promises)
-            res->addExtraPoolEntry(c->container());
+            res->addExtraPoolEntry(c);
 
         labels.clear();
         patchpoints.clear();
@@ -117,6 +117,7 @@ static Sources hasSources(Opcode bc) {
     case Opcode::ldvar_super_:
     case Opcode::stvar_:
     case Opcode::stvar_cached_:
+    case Opcode::stvar_loop_:
     case Opcode::stvar_super_:
     case Opcode::guard_fun_:
     case Opcode::call_:
@@ -238,7 +239,7 @@ void CodeVerifier::verifyFunctionLayout(SEXP sexp, InterpreterInstance* ctx) {
     std::vector<Code*> objs;
     objs.push_back(f->body());
     for (size_t i = 0; i < f->nargs(); ++i)
-        if (f->defaultArg(i))
+        if (f->isDefaultArgCompiled(i))
             objs.push_back(f->defaultArg(i));
 
     if (f->size > XLENGTH(sexp))
@@ -304,6 +305,7 @@ void CodeVerifier::verifyFunctionLayout(SEXP sexp, InterpreterInstance* ctx) {
             }
             if (*cptr == Opcode::ldvar_cached_ ||
                 *cptr == Opcode::stvar_cached_ ||
+                *cptr == Opcode::stvar_loop_ ||
                 *cptr == Opcode::ldvar_for_update_cache_) {
                 unsigned* argsIndex = reinterpret_cast<Immediate*>(cptr + 1);
                 if (*argsIndex >= cp_pool_length(ctx))
@@ -330,7 +332,13 @@ void CodeVerifier::verifyFunctionLayout(SEXP sexp, InterpreterInstance* ctx) {
             if (*cptr == Opcode::mk_promise_ ||
                 *cptr == Opcode::mk_eager_promise_) {
                 unsigned* promidx = reinterpret_cast<Immediate*>(cptr + 1);
-                objs.push_back(c->getPromise(*promidx));
+                if (*promidx >= c->extraPoolSize)
+                    Rf_error("RIR Verifier: Invalid promise index");
+                // Promises which are not compiled yet hold their AST
+                if (c->isPromiseCompiled(*promidx))
+                    objs.push_back(c->getPromise(*promidx));
+                else if (TYPEOF(c->getExtraPoolEntry(*promidx)) != LANGSXP)
+                    Rf_error("RIR Verifier: Invalid promise");
             }
             if (*cptr == Opcode::named_call_) {
                 uint32_t nargs = *reinterpret_cast<Immediate*>(cptr + 1);
@@ -37,6 +37,25 @@ static bool isConstant(SEXP exp) {
     }
 }
 
+static bool containsBreakOrNext(SEXP exp) {
+    if (TYPEOF(exp) != LANGSXP)
+        return false;
+    if (CAR(exp) == symbol::Break || CAR(exp) == symbol::Next)
+        return true;
+    for (auto e = exp; e != R_NilValue; e = CDR(e))
+        if (containsBreakOrNext(CAR(e)))
+            return true;
+    return false;
+}
+
+// Promises are compiled on first use. Symbols and constants are cheap to
+// compile right away. Break and next need the loops of the code they are
+// compiled in.
+static bool deferPromise(SEXP exp) {
+    return Compiler::lazyPromises && TYPEOF(exp) == LANGSXP &&
+           !containsBreakOrNext(exp);
+}
+
 static bool containsLoop(SEXP exp) {
     if (TYPEOF(exp) != LANGSXP)
         return false;
@@ -391,6 +410,12 @@ bool compileSimpleFor(CompilerContext& ctx, SEXP fullAst, SEXP sym, SEXP seq,
             //           following bytecode expects: lhs :: rhs :: step :: ...)
             cs << BC::swap() << BC::pick(2);
 
+            // After the peeled first iteration i is bound to a scalar created
+            // by this loop, which stvar_loop_ can overwrite. In the first
+            // iteration it could still be a value the enclosing code holds.
+            bool peel = Compiler::loopPeelingEnabled && !containsLoop(body);
+            bool peeled = false;
+
             // while
             compileWhile(
                 ctx,
@@ -399,15 +424,19 @@ bool compileSimpleFor(CompilerContext& ctx, SEXP fullAst, SEXP sym, SEXP seq,
                     cs << BC::dup2() << BC::ne();
                     cs.addSrc(R_NilValue);
                 },
-                [&ctx, &cs, &sym, &body]() {
+                [&ctx, &cs, &sym, &body, peel, &peeled]() {
                     // {
                     // i <- i'
                     cs << BC::dup();
-                    if (ctx.code.top()->isCached(sym))
+                    if (ctx.code.top()->isCached(sym) && peeled)
+                        cs << BC::stvarLoop(
+                            sym, ctx.code.top()->cacheSlotFor(sym));
+                    else if (ctx.code.top()->isCached(sym))
                         cs << BC::stvarCached(
                             sym, ctx.code.top()->cacheSlotFor(sym));
                     else
                         cs << BC::stvar(sym);
+                    peeled = peel;
                     // i' <- i' + step
                     cs << BC::pull(2) << BC::ensureNamed() << BC::add();
                     cs.addSrc(R_NilValue);
@@ -415,7 +444,7 @@ bool compileSimpleFor(CompilerContext& ctx, SEXP fullAst, SEXP sym, SEXP seq,
                     compileExpr(ctx, body, true);
                     // }
                 },
-                !containsLoop(body));
+                peel);
             cs << BC::popn(3);
             if (!voidContext)
                 cs << BC::push(R_NilValue) << BC::invisible();
@@ -1694,22 +1723,24 @@ static void compileLoadOneArg(CompilerContext& ctx, SEXP arg, ArgType arg_type,
         return;
     }
 
-    Code* prom;
+    SEXP prom;
     if (arg_type == ArgType::EAGER_PROMISE) {
         // Compile the expression to evaluate it eagerly, and
         // wrap the return value in a promise without rir code
         compileExpr(ctx, CAR(arg), false);
-        prom = compilePromiseNoRir(ctx, CAR(arg));
+        prom = compilePromiseNoRir(ctx, CAR(arg))->container();
     }
 
     else if (arg_type == ArgType::EAGER_PROMISE_FROM_TOS) {
         // The value we want to wrap in the argument's promise is
         // already on TOS, no nead to compile the expression.
         // Wrap it in a promise without rir code.
-        prom = compilePromiseNoRir(ctx, CAR(arg));
+        prom = compilePromiseNoRir(ctx, CAR(arg))->container();
     } else { // ArgType::PROMISE
-        // Compile the expression as a promise.
-        prom = compilePromise(ctx, CAR(arg));
+        // Compile the expression as a promise, or defer it to the first use.
+        prom = deferPromise(CAR(arg))
+                   ? CAR(arg)
+                   : compilePromise(ctx, CAR(arg))->container();
     }
 
     size_t idx = cs.addPromise(prom);
@@ -1964,6 +1995,8 @@ SEXP Compiler::finalize() {
     for (RListIter arg = RList(formals).begin(); arg != RList::end(); ++arg) {
         if (*arg == R_MissingArg) {
             function.addArgWithoutDefault();
+        } else if (deferPromise(*arg)) {
+            function.addDeferredDefaultArg(*arg);
         } else {
             Code* compiled = compilePromise(ctx, *arg);
             function.addDefaultArg(compiled);
@@ -1985,6 +2018,13 @@ SEXP Compiler::finalize() {
     return function.function()->container();
 }
 
+Code* Compiler::compileDeferredPromise(SEXP ast) {
+    FunctionWriter function;
+    Preserve preserve;
+    CompilerContext ctx(function, preserve);
+    return compilePromise(ctx, ast);
+}
+
 bool Compiler::unsoundOpts =
     !(getenv("UNSOUND_OPTS") &&
       std::string(getenv("UNSOUND_OPTS")).compare("off") == 0);
@@ -1995,4 +2035,8 @@ bool Compiler::profile =
 
 bool Compiler::loopPeelingEnabled = true;
 
+bool Compiler::lazyPromises =
+    !(getenv("RIR_LAZY_PROMISES") &&
+      std::string(getenv("RIR_LAZY_PROMISES")).compare("off") == 0);
+
 } // namespace rir
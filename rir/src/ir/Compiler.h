@@ -42,9 +42,14 @@ class Compiler {
     static bool profile;
     static bool unsoundOpts;
     static bool loopPeelingEnabled;
+    static bool lazyPromises;
 
     SEXP finalize();
 
+    // Compiles the code of a promise or default argument, which was deferred
+    // to its first use. See Code::getPromise and Function::defaultArg.
+    static Code* compileDeferredPromise(SEXP ast);
+
     static SEXP compileExpression(SEXP ast) {
 #if 0
         size_t count = 1;
@@ -1,9 +1,83 @@
 #include "Deoptimization.h"
 #include "R/Serialize.h"
 #include "runtime/Code.h"
+#include "runtime/RuntimeStats.h"
+#include "utils/Pool.h"
+
+#include <string>
+#include <unordered_map>
 
 namespace rir {
 
+static void writeVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static uint64_t readVarint(const uint8_t*& in) {
+    uint64_t v = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        uint8_t b = *in++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
+
+static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (v >> 63); }
+static int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(v & 1); }
+
+SEXP DeoptMetadata::compress(const std::vector<FrameInfo>& frames) {
+    std::string bytes;
+    writeVarint(bytes, frames.size());
+    intptr_t prev = 0;
+    for (auto& f : frames) {
+        writeVarint(bytes, zigzag((intptr_t)f.code - prev));
+        prev = (intptr_t)f.code;
+        writeVarint(bytes, f.pc - f.code->code());
+        writeVarint(bytes, f.stackSize << 1 | f.inPromise);
+    }
+
+    RuntimeStats::deoptMetadataUncompressedBytes += size(frames.size());
+
+    // The entries are in the constant pool, thus they are never collected
+    static std::unordered_map<std::string, SEXP> shared;
+    auto s = shared.find(bytes);
+    if (s != shared.end())
+        return s->second;
+
+    SEXP store = PROTECT(Rf_allocVector(RAWSXP, bytes.size()));
+    memcpy(RAW(store), bytes.data(), bytes.size());
+    Pool::insert(store);
+    UNPROTECT(1);
+    shared.emplace(bytes, store);
+    RuntimeStats::deoptMetadataBytes += bytes.size();
+    return store;
+}
+
+size_t DeoptMetadata::numFramesOf(const uint8_t* compressed) {
+    return readVarint(compressed);
+}
+
+void DeoptMetadata::decompress(const uint8_t* compressed,
+                               DeoptMetadata* res) {
+    res->numFrames = readVarint(compressed);
+    intptr_t prev = 0;
+    for (size_t i = 0; i < res->numFrames; ++i) {
+        auto& f = res->frames[i];
+        prev += unzigzag(readVarint(compressed));
+        f.code = (Code*)prev;
+        f.pc = f.code->code() + readVarint(compressed);
+        auto stack = readVarint(compressed);
+        f.stackSize = stack >> 1;
+        f.inPromise = stack & 1;
+    }
+    res->computeLayout();
+}
+
 void DeoptMetadata::print(std::ostream& out) const {
     for (size_t i = 0; i < numFrames; ++i) {
         auto f = frames[i];
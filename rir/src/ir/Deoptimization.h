@@ -3,6 +3,7 @@
 
 #include <R/r.h>
 #include <iostream>
+#include <vector>
 
 namespace rir {
 #pragma pack(push)
@@ -22,9 +23,37 @@ struct FrameInfo {
         : pc(pc), code(code), stackSize(stackSize), inPromise(promise) {}
 };
 
+/*
+ * The frames of a deopt site, innermost first. The backend stores them
+ * compressed, see compress, and they are only decoded when deoptimizing.
+ */
 struct DeoptMetadata {
     void print(std::ostream& out) const;
+
+    static size_t size(size_t numFrames) {
+        return sizeof(DeoptMetadata) + numFrames * sizeof(FrameInfo);
+    }
+
+    // Returns a RAWSXP with the varint encoding of frames: the number of
+    // frames, then per frame the zigzag delta of the code pointer to the
+    // previous frame, the pc offset into the code and the stack size with the
+    // inPromise flag. Equal frame chains share one constant pool entry.
+    static SEXP compress(const std::vector<FrameInfo>& frames);
+    static size_t numFramesOf(const uint8_t* compressed);
+    // res needs size(numFramesOf(compressed)) bytes
+    static void decompress(const uint8_t* compressed, DeoptMetadata* res);
+
+    // Precomputes the layout below, once all frames are filled in
+    void computeLayout() {
+        stackHeight = 0;
+        for (size_t i = 0; i < numFrames; ++i)
+            stackHeight += frames[i].stackSize + 1;
+    }
+
     size_t numFrames;
+    // Number of stack slots of all frames, each frame has its environment
+    // below its stack
+    size_t stackHeight;
     FrameInfo frames[];
 };
 
@@ -74,6 +74,14 @@ DEF_INSTR(stvar_, 1, 1, 0, 0)
  */
 DEF_INSTR(stvar_cached_, 2, 1, 0, 0)
 
+/**
+ * stvar_loop_:: like stvar_cached_, for the index variable of a for loop after
+ * its first iteration. If the variable is bound to a scalar of the same type
+ * that nothing else references, the value is written into that scalar instead
+ * of rebinding the variable.
+ */
+DEF_INSTR(stvar_loop_, 2, 1, 0, 0)
+
 /**
  * stvar_super_:: assign tos to the immediate symbol, lookup starts in the
  * enclosing environment
@@ -448,7 +456,7 @@ DEF_INSTR(ret_, 0, 1, 0, 1)
  * heavy in size.
  */
 DEF_INSTR(record_call_, 4, 1, 1, 0)
-DEF_INSTR(record_type_, 1, 1, 1, 0)
+DEF_INSTR(record_type_, 2, 1, 1, 0)
 DEF_INSTR(record_test_, 1, 1, 1, 0)
 
 DEF_INSTR(int3_, 0, 0, 0, 0)
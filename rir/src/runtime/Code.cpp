@@ -3,8 +3,10 @@
 #include "R/Printing.h"
 #include "R/Serialize.h"
 #include "ir/BC.h"
+#include "ir/Compiler.h"
 #include "utils/Pool.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 
@@ -44,6 +46,166 @@ Code* Code::New(Immediate ast, size_t codeSize, size_t sources, size_t locals,
 
 Code* Code::New(Immediate ast) { return New(ast, 0, 0, 0, 0); }
 
+Code* Code::clone() const {
+    SEXP store = Rf_allocVector(EXTERNALSXP, size());
+    PROTECT(store);
+    memcpy(DATAPTR(store), this, size());
+    Code* res = Code::unpack(store);
+    res->nativeCode = nullptr;
+    res->nativeCodeSize = 0;
+    res->funInvocationCount = 0;
+    res->deoptCount = 0;
+    res->deadCallReached = 0;
+    res->isDeoptimized = false;
+    res->setEntry(1, nullptr);
+
+    // The copy needs its own extra pool, since recording call feedback adds
+    // entries to it
+    SEXP pool = getEntry(0);
+    if (pool != R_NilValue) {
+        SEXP newPool = Rf_allocVector(VECSXP, LENGTH(pool));
+        res->setEntry(0, newPool);
+        for (unsigned i = 0; i < extraPoolSize; ++i)
+            SET_VECTOR_ELT(newPool, i, VECTOR_ELT(pool, i));
+
+        std::vector<BC::FunIdx> promises;
+        for (auto pc = code(); pc < endCode(); pc = BC::next(pc))
+            BC::decodeShallow(pc).addMyPromArgsTo(promises);
+        for (auto i : promises)
+            if (isPromiseCompiled(i))
+                SET_VECTOR_ELT(newPool, i,
+                               getPromise(i)->clone()->container());
+    }
+
+    res->resetFeedback();
+    UNPROTECT(1);
+    return res;
+}
+
+void Code::resetFeedback(const Opcode* keep) {
+    funInvocationCount = 0;
+    deadCallReached = 0;
+    for (auto pc = code(); pc < endCode(); pc = BC::next(pc)) {
+        if (pc == keep)
+            continue;
+        switch (*pc) {
+        case Opcode::record_call_:
+            memset(pc + 1, 0, sizeof(ObservedCallees));
+            break;
+        case Opcode::record_test_:
+            *(ObservedTest*)(pc + 1) = ObservedTest();
+            break;
+        case Opcode::record_type_:
+            ((ObservedValues*)(pc + 1))->reset();
+            break;
+        default: {}
+        }
+    }
+    std::vector<BC::FunIdx> promises;
+    for (auto pc = code(); pc < endCode(); pc = BC::next(pc))
+        BC::decodeShallow(pc).addMyPromArgsTo(promises);
+    for (auto i : promises)
+        if (isPromiseCompiled(i))
+            getPromise(i)->resetFeedback(keep);
+}
+
+void Code::decayFeedback() {
+    for (auto pc = code(); pc < endCode(); pc = BC::next(pc)) {
+        switch (*pc) {
+        case Opcode::record_call_: {
+            auto feedback = (ObservedCallees*)(pc + 1);
+            // Round up, a call that was taken should not look dead
+            feedback->taken = (feedback->taken + 1) / 2;
+            if (feedback->numTargets == ObservedCallees::MaxTargets)
+                feedback->numTargets = 0;
+            break;
+        }
+        case Opcode::record_test_: {
+            auto feedback = (ObservedTest*)(pc + 1);
+            if (feedback->seen == ObservedTest::Both)
+                *feedback = ObservedTest();
+            break;
+        }
+        case Opcode::record_type_: {
+            auto feedback = (ObservedValues*)(pc + 1);
+            if (feedback->numTypes == ObservedValues::MaxTypes)
+                feedback->reset();
+            break;
+        }
+        default: {}
+        }
+    }
+    std::vector<BC::FunIdx> promises;
+    for (auto pc = code(); pc < endCode(); pc = BC::next(pc))
+        BC::decodeShallow(pc).addMyPromArgsTo(promises);
+    for (auto i : promises)
+        if (isPromiseCompiled(i))
+            getPromise(i)->decayFeedback();
+}
+
+bool Code::importFeedback(const Code* other) {
+    if (codeSize != other->codeSize || !sameOpcodes(other))
+        return false;
+
+    std::vector<BC::FunIdx> promises;
+    for (auto pc = code(), opc = other->code(); pc < endCode();
+         pc = BC::next(pc), opc = BC::next(opc)) {
+        switch (*pc) {
+        case Opcode::record_call_: {
+            auto feedback = (ObservedCallees*)(pc + 1);
+            auto saved = (ObservedCallees*)(opc + 1);
+            // Targets live in the extra pool, they are added to ours. Only
+            // builtins are deserialized to the objects of this session,
+            // closures are copies that a guard on the callee never matches.
+            for (size_t i = 0; i < saved->numTargets; ++i) {
+                auto target = saved->getTarget(other, i);
+                if (TYPEOF(target) == BUILTINSXP ||
+                    TYPEOF(target) == SPECIALSXP)
+                    feedback->record(this, target);
+            }
+            feedback->taken = std::max(feedback->taken, saved->taken);
+            break;
+        }
+        case Opcode::record_test_: {
+            auto feedback = (ObservedTest*)(pc + 1);
+            auto saved = (ObservedTest*)(opc + 1);
+            if (feedback->seen == ObservedTest::None)
+                feedback->seen = saved->seen;
+            else if (saved->seen != ObservedTest::None &&
+                     saved->seen != feedback->seen)
+                feedback->seen = ObservedTest::Both;
+            break;
+        }
+        case Opcode::record_type_: {
+            // Failed typechecks of the previous run are not imported, our
+            // own deopts are kept
+            auto feedback = (ObservedValues*)(pc + 1);
+            if (feedback->numTypes == 0) {
+                auto deopts = feedback->numDeopts;
+                *feedback = *(ObservedValues*)(opc + 1);
+                feedback->numDeopts = deopts;
+            }
+            break;
+        }
+        default: {}
+        }
+        BC::decodeShallow(pc).addMyPromArgsTo(promises);
+    }
+    for (auto i : promises)
+        if (other->isPromiseCompiled(i))
+            getPromise(i)->importFeedback(other->getPromise(i));
+    return true;
+}
+
+// Immediates are not compared, pool indices differ between runs
+bool Code::sameOpcodes(const Code* other) const {
+    for (auto pc = code(), opc = other->code(); pc < endCode();
+         pc = BC::next(pc), opc = BC::next(opc))
+        if (*pc != *opc)
+            return false;
+    return true;
+}
+
 Code::~Code() {
     // TODO: Not sure if this is actually called
     // Otherwise the pointer will leak a few bytes
@@ -252,6 +414,11 @@ void Code::disassemble(std::ostream& out, const std::string& prefix) const {
     }
 
     for (auto i : promises) {
+        if (!isPromiseCompiled(i)) {
+            out << "\n[Prom (index " << prefix << i << ")] not compiled: "
+                << Print::dumpSexp(getExtraPoolEntry(i)) << "\n";
+            continue;
+        }
         auto c = getPromise(i);
         out << "\n[Prom (index " << prefix << i << ")]\n";
         std::stringstream ss;
@@ -280,6 +447,20 @@ void Code::print(std::ostream& out) const {
     disassemble(out);
 }
 
+size_t Code::totalNativeCodeSize() const {
+    size_t size = nativeCodeSize;
+    for (unsigned i = 0; i < extraPoolSize; ++i)
+        if (auto prom = Code::check(getExtraPoolEntry(i)))
+            size += prom->totalNativeCodeSize();
+    return size;
+}
+
+Code* Code::compilePromise(size_t idx) const {
+    Code* prom = Compiler::compileDeferredPromise(getExtraPoolEntry(idx));
+    SET_VECTOR_ELT(getEntry(0), idx, prom->container());
+    return prom;
+}
+
 unsigned Code::addExtraPoolEntry(SEXP v) {
     SEXP cur = getEntry(0);
     unsigned curLen = cur == R_NilValue ? 0 : (unsigned)LENGTH(cur);
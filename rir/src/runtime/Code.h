@@ -72,7 +72,26 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
                      size_t locals, size_t bindingCache);
     static Code* New(Immediate ast);
 
+    // Copy of this code and its promises, with empty type feedback
+    Code* clone() const;
+    // Clears all feedback of this code and its promises, except for the slot
+    // of the record_ instruction at keep. The invocation and dead call
+    // counters are cleared too, otherwise calls that did not run again since
+    // would look dead to rir2pir.
+    void resetFeedback(const Opcode* keep = nullptr);
+    // Halves the call counters and clears feedback that saturated, such that
+    // it can adapt to a new phase of the program
+    void decayFeedback();
+    // Adds the feedback recorded by other, a copy of this code from a previous
+    // run, to this code and its promises. Returns false if the bytecode does
+    // not match, in which case nothing is imported.
+    bool importFeedback(const Code* other);
+
     NativeCode nativeCode;
+    // size in bytes of the machine code behind nativeCode
+    unsigned nativeCodeSize = 0;
+    // nativeCodeSize including the promises in the extra pool
+    size_t totalNativeCodeSize() const;
 
     static unsigned pad4(unsigned sizeInBytes) {
         unsigned x = sizeInBytes % 4;
@@ -163,8 +182,15 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
         return VECTOR_ELT(getEntry(0), i);
     }
 
+    // Promises are compiled on first use, until then the extra pool holds
+    // their AST. See Compiler::compileDeferredPromise.
     Code* getPromise(size_t idx) const {
-        return unpack(getExtraPoolEntry(idx));
+        if (auto prom = check(getExtraPoolEntry(idx)))
+            return prom;
+        return compilePromise(idx);
+    }
+    bool isPromiseCompiled(size_t idx) const {
+        return check(getExtraPoolEntry(idx));
     }
 
     PirTypeFeedback* pirTypeFeedback() const {
@@ -209,6 +235,9 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
     }
 
   private:
+    Code* compilePromise(size_t idx) const;
+    bool sameOpcodes(const Code* other) const;
+
     SrclistEntry* srclist() const {
         return (SrclistEntry*)(data + pad4(codeSize));
     }
@@ -0,0 +1,104 @@
+#include "CodeCache.h"
+#include "DispatchTable.h"
+#include "RuntimeStats.h"
+#include "compiler/native/builtins.h"
+#include "compiler/parameter.h"
+
+#include <list>
+
+namespace rir {
+
+size_t pir::Parameter::RIR_CODE_CACHE_BUDGET =
+    getenv("PIR_CODE_CACHE_BUDGET") ? atol(getenv("PIR_CODE_CACHE_BUDGET"))
+                                    : 0;
+
+namespace {
+
+struct Entry {
+    // Preserved list of the dispatch table and the version
+    SEXP roots;
+    size_t size;
+    size_t lastInvocations;
+    size_t lastUsed;
+
+    DispatchTable* table() const {
+        return DispatchTable::unpack(VECTOR_ELT(roots, 0));
+    }
+    Function* fun() const { return Function::unpack(VECTOR_ELT(roots, 1)); }
+};
+
+std::list<Entry> entries;
+size_t total = 0;
+size_t epoch = 0;
+
+bool installed(DispatchTable* table, Function* fun) {
+    for (size_t i = 1; i < table->size(); ++i)
+        if (table->get(i) == fun)
+            return true;
+    return false;
+}
+
+void forget(std::list<Entry>::iterator e) {
+    total -= e->size;
+    R_ReleaseObject(e->roots);
+    entries.erase(e);
+}
+
+} // namespace
+
+void CodeCache::install(DispatchTable* table, Function* fun) {
+    if (!pir::Parameter::RIR_CODE_CACHE_BUDGET)
+        return;
+
+    if (table->registerRecompilation(fun->context()))
+        RuntimeStats::codeCacheRecompiles++;
+
+    SEXP roots = Rf_allocVector(VECSXP, 2);
+    R_PreserveObject(roots);
+    SET_VECTOR_ELT(roots, 0, table->container());
+    SET_VECTOR_ELT(roots, 1, fun->container());
+    auto size = fun->body()->totalNativeCodeSize();
+    entries.push_back({roots, size, 0, ++epoch});
+    total += size;
+
+    // Refresh recency and forget versions which already left their dispatch
+    // table, e.g. because they were replaced. Deoptimized versions are not
+    // dispatched to anymore, thus they are evicted first.
+    for (auto e = entries.begin(); e != entries.end();) {
+        auto cur = e++;
+        auto f = cur->fun();
+        if (!installed(cur->table(), f)) {
+            forget(cur);
+            continue;
+        }
+        if (f->body()->isDeoptimized)
+            cur->lastUsed = 0;
+        else if (f->invocationCount() != cur->lastInvocations) {
+            cur->lastInvocations = f->invocationCount();
+            cur->lastUsed = epoch;
+        }
+    }
+
+    if (total <= pir::Parameter::RIR_CODE_CACHE_BUDGET)
+        return;
+
+    // The new version is last and never evicted, stable sorting keeps it there
+    entries.sort([](const Entry& a, const Entry& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+    while (total > pir::Parameter::RIR_CODE_CACHE_BUDGET &&
+           entries.size() > 1) {
+        auto e = entries.begin();
+        auto t = e->table();
+        auto f = e->fun();
+        t->remove(f->body());
+        pir::NativeBuiltins::invalidateTargetCaches(f->body());
+        t->registerEviction(f->context());
+        RuntimeStats::codeCacheEvictions++;
+        forget(e);
+    }
+}
+
+size_t CodeCache::size() { return total; }
+
+} // namespace rir
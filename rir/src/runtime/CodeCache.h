@@ -0,0 +1,33 @@
+#ifndef RIR_CODE_CACHE_H
+#define RIR_CODE_CACHE_H
+
+#include <cstddef>
+
+namespace rir {
+
+struct DispatchTable;
+struct Function;
+
+/*
+ * Keeps the native code of the optimized versions within
+ * Parameter::RIR_CODE_CACHE_BUDGET bytes, 0 means unlimited.
+ *
+ * Recency is approximated without touching the call path: every install
+ * compares the invocation counts of all tracked versions with the previous
+ * install, versions that were called since count as used now. Over budget the
+ * least recently used versions are removed from their dispatch table, such
+ * that calls fall back to the baseline or a more generic version. The machine
+ * code is released by the GC, once no promise or frame refers to the evicted
+ * code anymore, see PirJitLLVM::finalizeAndFixup.
+ */
+class CodeCache {
+  public:
+    static void install(DispatchTable* table, Function* fun);
+
+    // Bytes of native code of the tracked versions
+    static size_t size();
+};
+
+} // namespace rir
+
+#endif
@@ -4,6 +4,7 @@
 #include "Function.h"
 #include "R/Serialize.h"
 #include "RirRuntimeObject.h"
+#include "compiler/parameter.h"
 #include "utils/random.h"
 
 namespace rir {
@@ -219,6 +220,56 @@ struct DispatchTable
         return userDefinedContext_ | anotherContext;
     }
 
+    // Versions which deoptimize soon after they were compiled make the
+    // recompilation of this function back off exponentially. Versions which
+    // survive DEOPT_STORM_WINDOW invocations slowly reduce the backoff again.
+    static constexpr unsigned MaxRecompileBackoff = 10;
+    unsigned recompileBackoff() const { return recompileBackoff_; }
+
+    // Returns true if this deopt is part of a deoptimization storm
+    bool registerDeopt(Code* version) {
+        deopts_++;
+        if (version->funInvocationCount < pir::Parameter::DEOPT_STORM_WINDOW) {
+            if (recompileBackoff_ < MaxRecompileBackoff)
+                recompileBackoff_++;
+            return true;
+        }
+        if (recompileBackoff_ > 0)
+            recompileBackoff_--;
+        return false;
+    }
+
+    // Statistics for rir.stats
+    size_t deopts() const { return deopts_; }
+    size_t compilations() const { return compilations_; }
+    double compileTime() const { return compileTime_; }
+    void registerCompilation(double seconds) {
+        compilations_++;
+        compileTime_ += seconds;
+    }
+
+    // Contexts of versions evicted by the CodeCache, to count their
+    // recompilations. Only the most recent evictions are remembered.
+    static constexpr size_t MaxEvicted = 4;
+    void registerEviction(const Context& context) {
+        if (numEvicted_ == MaxEvicted) {
+            for (size_t i = 1; i < MaxEvicted; ++i)
+                evicted_[i - 1] = evicted_[i];
+            numEvicted_--;
+        }
+        evicted_[numEvicted_++] = context;
+    }
+    // Returns true if a version with this context was evicted before
+    bool registerRecompilation(const Context& context) {
+        for (size_t i = 0; i < numEvicted_; ++i) {
+            if (evicted_[i] == context) {
+                evicted_[i] = evicted_[--numEvicted_];
+                return true;
+            }
+        }
+        return false;
+    }
+
   private:
     DispatchTable() = delete;
     explicit DispatchTable(size_t cap)
@@ -230,6 +281,12 @@ struct DispatchTable
 
     size_t size_ = 0;
     Context userDefinedContext_;
+    unsigned recompileBackoff_ = 0;
+    size_t deopts_ = 0;
+    size_t compilations_ = 0;
+    double compileTime_ = 0;
+    Context evicted_[MaxEvicted];
+    size_t numEvicted_ = 0;
 };
 #pragma pack(pop)
 } // namespace rir
@@ -1,6 +1,8 @@
 #include "Function.h"
 #include "R/Serialize.h"
 #include "compiler/compiler.h"
+#include "compiler/parameter.h"
+#include "ir/Compiler.h"
 
 namespace rir {
 
@@ -13,7 +15,7 @@ Function* Function::deserialize(SEXP refTable, R_inpstream_t inp) {
     Function* fun = new (payload) Function(functionSize, NULL, {}, sig, as);
     fun->numArgs_ = InInteger(inp);
     fun->info.gc_area_length += fun->numArgs_;
-    for (unsigned i = 0; i < fun->numArgs_ + 1; i++) {
+    for (unsigned i = 0; i < fun->numArgs_ + NUM_PTRS; i++) {
         fun->setEntry(i, R_NilValue);
     }
     PROTECT(store);
@@ -32,6 +34,7 @@ Function* Function::deserialize(SEXP refTable, R_inpstream_t inp) {
             fun->setEntry(Function::NUM_PTRS + i, nullptr);
     }
     fun->flags = EnumSet<Flag>(InInteger(inp));
+    fun->setEntry(1, ReadItem(refTable, inp));
     UNPROTECT(protectCount);
     return fun;
 }
@@ -50,6 +53,10 @@ void Function::serialize(SEXP refTable, R_outpstream_t out) const {
             defaultArg(i)->serialize(refTable, out);
     }
     OutInteger(out, flags.to_i());
+    // The feedback splits, such that a deserialized baseline is optimized
+    // from the same feedback
+    SEXP splits = getEntry(1);
+    WriteItem(splits ? splits : R_NilValue, refTable, out);
 }
 
 void Function::disassemble(std::ostream& out) {
@@ -88,4 +95,80 @@ void Function::clearDisabledAssumptions(Context& given) const {
         given.setSpecializationLevel(GLOBAL_SPECIALIZATION_LEVEL);
 }
 
+Function* Function::feedbackSplit(Context given, bool create) {
+    if (!pir::Parameter::RIR_FEEDBACK_SPLITS ||
+        signature().optimization !=
+            FunctionSignature::OptimizationLevel::Baseline)
+        return nullptr;
+
+    // Feedback is split by the types of scalar arguments
+    clearDisabledAssumptions(given);
+    Context key;
+    for (size_t i = 0; i < Context::NUM_TYPED_ARGS; ++i) {
+        if (given.isSimpleInt(i))
+            key.setSimpleInt(i);
+        else if (given.isSimpleReal(i))
+            key.setSimpleReal(i);
+    }
+    if (key.empty())
+        return nullptr;
+
+    SEXP splits = getEntry(1);
+    size_t i = 0;
+    if (splits && splits != R_NilValue) {
+        for (; i < (size_t)LENGTH(splits); ++i) {
+            SEXP split = VECTOR_ELT(splits, i);
+            if (split == R_NilValue)
+                break;
+            if (Function::unpack(split)->context() == key)
+                return Function::unpack(split);
+        }
+    }
+    if (!create || i == pir::Parameter::RIR_FEEDBACK_SPLITS)
+        return nullptr;
+
+    if (!splits || splits == R_NilValue) {
+        splits = Rf_allocVector(VECSXP, pir::Parameter::RIR_FEEDBACK_SPLITS);
+        setEntry(1, splits);
+    }
+    SEXP splitBody = PROTECT(body()->clone()->container());
+    std::vector<SEXP> defaultArgs;
+    for (size_t j = 0; j < numArgs_; ++j)
+        defaultArgs.push_back(getEntry(NUM_PTRS + j));
+    SEXP store = Rf_allocVector(EXTERNALSXP, size);
+    auto split = new (INTEGER(store))
+        Function(size, splitBody, defaultArgs, signature(), key);
+    split->flags = flags;
+    SET_VECTOR_ELT(splits, i, store);
+    UNPROTECT(1);
+    return split;
+}
+
+Code* Function::compileDefaultArg(size_t i) const {
+    Code* arg = Compiler::compileDeferredPromise(defaultArg_[i]);
+    const_cast<Function*>(this)->setEntry(NUM_PTRS + i, arg->container());
+    return arg;
+}
+
+void Function::resetFeedback(const Opcode* keep) {
+    body()->resetFeedback(keep);
+    SEXP splits = getEntry(1);
+    if (splits && splits != R_NilValue)
+        for (size_t i = 0; i < (size_t)LENGTH(splits); ++i)
+            if (VECTOR_ELT(splits, i) != R_NilValue)
+                Function::unpack(VECTOR_ELT(splits, i))->resetFeedback(keep);
+}
+
+void Function::decayFeedback() {
+    body()->decayFeedback();
+    SEXP splits = getEntry(1);
+    if (splits && splits != R_NilValue)
+        for (size_t i = 0; i < (size_t)LENGTH(splits); ++i)
+            if (VECTOR_ELT(splits, i) != R_NilValue)
+                Function::unpack(VECTOR_ELT(splits, i))->decayFeedback();
+}
+
+unsigned pir::Parameter::RIR_FEEDBACK_SPLITS =
+    getenv("PIR_FEEDBACK_SPLITS") ? atoi(getenv("PIR_FEEDBACK_SPLITS")) : 0;
+
 } // namespace rir
@@ -39,7 +39,7 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     friend class FunctionCodeIterator;
     friend class ConstFunctionCodeIterator;
 
-    static constexpr size_t NUM_PTRS = 1;
+    static constexpr size_t NUM_PTRS = 2;
 
     Function(size_t functionSize, SEXP body_,
              const std::vector<SEXP>& defaultArgs,
@@ -62,13 +62,45 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     void serialize(SEXP refTable, R_outpstream_t out) const;
     void disassemble(std::ostream&);
 
+    // Default arguments are compiled on first use, until then the slot holds
+    // their AST. See Compiler::compileDeferredPromise.
     Code* defaultArg(size_t i) const {
         assert(i < numArgs_);
         if (!defaultArg_[i])
             return nullptr;
-        return Code::unpack(defaultArg_[i]);
+        if (auto arg = Code::check(defaultArg_[i]))
+            return arg;
+        return compileDefaultArg(i);
+    }
+    bool hasDefaultArg(size_t i) const {
+        assert(i < numArgs_);
+        return defaultArg_[i];
+    }
+    bool isDefaultArgCompiled(size_t i) const {
+        return hasDefaultArg(i) && Code::check(defaultArg_[i]);
     }
 
+    // Copies of the baseline, which collect their own type feedback for calls
+    // with different argument types. Returns the copy for the given context,
+    // if there is one, or creates it. See Parameter::RIR_FEEDBACK_SPLITS.
+    Function* feedbackSplit(Context given, bool create = false);
+    // The list of feedback splits, R_NilValue or nullptr if there are none
+    SEXP feedbackSplits() const { return getEntry(1); }
+    size_t numFeedbackSplits() const {
+        SEXP splits = feedbackSplits();
+        size_t n = 0;
+        if (splits && splits != R_NilValue)
+            while (n < (size_t)LENGTH(splits) &&
+                   VECTOR_ELT(splits, n) != R_NilValue)
+                n++;
+        return n;
+    }
+
+    // Reset or decay the type feedback of the body and all feedback splits.
+    // See Code::resetFeedback and Code::decayFeedback.
+    void resetFeedback(const Opcode* keep = nullptr);
+    void decayFeedback();
+
     void unregisterInvocation() { body()->unregisterInvocation(); }
     void registerInvocation() { body()->registerInvocation(); }
     size_t invocationCount() { return body()->funInvocationCount; }
@@ -122,13 +154,15 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     const Context& context() const { return context_; }
 
   private:
+    Code* compileDefaultArg(size_t i) const;
+
     unsigned numArgs_;
 
     FunctionSignature signature_; /// pointer to this version's signature
     Context context_;
 
     // !!! SEXPs traceable by the GC must be declared here !!!
-    // locals contains: body
+    // locals contains: body, feedback splits
     CodeSEXP locals[NUM_PTRS];
     CodeSEXP defaultArg_[];
 };
@@ -1,9 +1,49 @@
 #include "LazyEnvironment.h"
 #include "utils/Pool.h"
 
+#include <map>
+#include <vector>
+
 namespace rir {
 
+SEXP LazyEnvironmentSlots::create(size_t nargs, const Immediate* names) {
+    // The entries are in the constant pool, thus they are never collected
+    static std::map<std::vector<Immediate>, SEXP> shared;
+    std::vector<Immediate> key(names, names + nargs);
+    auto s = shared.find(key);
+    if (s != shared.end())
+        return s->second;
+
+    size_t capacity = 1;
+    while (capacity < 2 * nargs)
+        capacity <<= 1;
+    SEXP store = PROTECT(Rf_allocVector(
+        RAWSXP, sizeof(LazyEnvironmentSlots) + capacity * sizeof(Entry)));
+    auto slots = new (DATAPTR(store)) LazyEnvironmentSlots;
+    slots->capacity = capacity;
+    memset(slots->entries, 0, capacity * sizeof(Entry));
+    for (size_t i = 0; i < nargs; ++i) {
+        // Names of arguments which might be missing are wrapped in a list
+        // cell. They are not found by name, same as with getArgIdx below.
+        SEXP n = Pool::get(names[i]);
+        if (TYPEOF(n) != SYMSXP)
+            continue;
+        auto pos = hash(n) & (capacity - 1);
+        while (slots->entries[pos].name && slots->entries[pos].name != n)
+            pos = (pos + 1) & (capacity - 1);
+        // The first binding wins, like in the linear scan
+        if (!slots->entries[pos].name)
+            slots->entries[pos] = {n, (uint32_t)i};
+    }
+    Pool::insert(store);
+    UNPROTECT(1);
+    shared.emplace(key, store);
+    return store;
+}
+
 size_t LazyEnvironment::getArgIdx(SEXP n) {
+    if (slots)
+        return slots->find(n, nargs);
     size_t i = 0;
     while (i < nargs) {
         if (Pool::get(names[i]) == n)
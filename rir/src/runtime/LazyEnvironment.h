@@ -14,6 +14,40 @@ namespace rir {
 
 #define LAZY_ENVIRONMENT_MAGIC 0xe4210e47
 
+/**
+ * Maps the argument names of an environment stub to their slots. This is an
+ * open addressing hash table keyed by the symbol. It is created when the MkEnv
+ * is lowered and shared by all stubs created there. Symbols are never
+ * collected, thus the table does not need to be traced by the gc.
+ */
+struct LazyEnvironmentSlots {
+    struct Entry {
+        SEXP name;
+        uint32_t slot;
+    };
+
+    size_t capacity;
+    Entry entries[];
+
+    // Returns the table for the names, it is kept alive by the constant pool
+    static SEXP create(size_t nargs, const Immediate* names);
+
+    size_t find(SEXP name, size_t notFound) const {
+        auto mask = capacity - 1;
+        for (auto i = hash(name) & mask;; i = (i + 1) & mask) {
+            if (entries[i].name == name)
+                return entries[i].slot;
+            if (!entries[i].name)
+                return notFound;
+        }
+    }
+
+    static size_t hash(SEXP name) {
+        auto h = (uintptr_t)name >> 4;
+        return (h ^ (h >> 16)) * 0x9E3779B1;
+    }
+};
+
 /**
  * EnvironmentStub holds the information needed to create an
  * environment lazily.
@@ -25,10 +59,11 @@ struct LazyEnvironment
     LazyEnvironment& operator=(const LazyEnvironment&) = delete;
     constexpr static int ArgOffset = 2;
 
-    LazyEnvironment(SEXP parent, size_t nargs, Immediate* names)
+    LazyEnvironment(SEXP parent, size_t nargs, Immediate* names,
+                    const LazyEnvironmentSlots* slots)
         : RirRuntimeObject(sizeof(LazyEnvironment) + sizeof(char) * nargs,
                            nargs + ArgOffset),
-          nargs(nargs), names(names) {
+          nargs(nargs), names(names), slots(slots) {
         memset(missing, 0, sizeof(char) * nargs);
     }
 
@@ -37,6 +72,8 @@ struct LazyEnvironment
 
     size_t nargs;
     Immediate* names;
+    // Optional, without it lookups by name scan the names
+    const LazyEnvironmentSlots* slots;
 
     SEXP getArg(size_t i) { return getEntry(i + ArgOffset); }
     void setArg(size_t i, SEXP val, bool overrideMissing) {
@@ -57,13 +94,14 @@ struct LazyEnvironment
         }
     }
 
-    static LazyEnvironment* BasicNew(SEXP parent, size_t nargs,
-                                     Immediate* names) {
+    static LazyEnvironment*
+    BasicNew(SEXP parent, size_t nargs, Immediate* names,
+             const LazyEnvironmentSlots* slots = nullptr) {
         SEXP wrapper = Rf_allocVector(
             EXTERNALSXP, sizeof(LazyEnvironment) + sizeof(char) * nargs +
                              sizeof(SEXP) * (nargs + ArgOffset));
         auto le = new (DATAPTR(wrapper))
-            LazyEnvironment(parent, nargs, (Immediate*)names);
+            LazyEnvironment(parent, nargs, (Immediate*)names, slots);
         le->setEntry(1, parent);
         assert(LazyEnvironment::check(wrapper));
         return le;
@@ -0,0 +1,97 @@
+#include "RuntimeStats.h"
+#include "DispatchTable.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace rir {
+
+const char* RuntimeStats::deoptReasonNames[NumDeoptReasons] = {
+    "None",       "Typecheck",           "DeadCall",
+    "Calltarget", "EnvStubMaterialized", "DeadBranchReached"};
+
+size_t RuntimeStats::deopts[NumDeoptReasons] = {};
+size_t RuntimeStats::bindingCacheHits = 0;
+size_t RuntimeStats::bindingCacheMisses = 0;
+size_t RuntimeStats::globalBindingCacheHits = 0;
+size_t RuntimeStats::globalBindingCacheMisses = 0;
+size_t RuntimeStats::globalBindingCacheUncacheable = 0;
+size_t RuntimeStats::promisesRecycled = 0;
+size_t RuntimeStats::loopVarsUpdatedInPlace = 0;
+size_t RuntimeStats::compilations = 0;
+double RuntimeStats::compileTime = 0;
+size_t RuntimeStats::failedCompilations = 0;
+size_t RuntimeStats::codeCacheEvictions = 0;
+size_t RuntimeStats::codeCacheRecompiles = 0;
+size_t RuntimeStats::nativeModulesReleased = 0;
+size_t RuntimeStats::deoptMetadataBytes = 0;
+size_t RuntimeStats::deoptMetadataUncompressedBytes = 0;
+size_t RuntimeStats::llvmCodeBytes = 0;
+size_t RuntimeStats::llvmDataBytes = 0;
+size_t RuntimeStats::llvmHighWater = 0;
+
+void RuntimeStats::llvmAllocated(size_t bytes, bool code) {
+    if (code)
+        llvmCodeBytes += bytes;
+    else
+        llvmDataBytes += bytes;
+    llvmHighWater = std::max(llvmHighWater, llvmCodeBytes + llvmDataBytes);
+}
+
+void RuntimeStats::llvmReleased(size_t code, size_t data) {
+    llvmCodeBytes -= code;
+    llvmDataBytes -= data;
+}
+
+void RuntimeStats::reset() {
+    for (auto& d : deopts)
+        d = 0;
+    bindingCacheHits = 0;
+    bindingCacheMisses = 0;
+    globalBindingCacheHits = 0;
+    globalBindingCacheMisses = 0;
+    globalBindingCacheUncacheable = 0;
+    promisesRecycled = 0;
+    loopVarsUpdatedInPlace = 0;
+    compilations = 0;
+    compileTime = 0;
+    failedCompilations = 0;
+    codeCacheEvictions = 0;
+    codeCacheRecompiles = 0;
+    nativeModulesReleased = 0;
+}
+
+static size_t bytes(SEXP container) { return XLENGTH(container); }
+
+ClosureMemory::ClosureMemory(DispatchTable* table)
+    : dispatchTable(bytes(table->container())) {
+    std::function<void(Code*)> addCode = [&](Code* c) {
+        code += bytes(c->container());
+        nativeCode += c->nativeCodeSize;
+        if (auto feedback = c->pirTypeFeedback())
+            typeFeedback += bytes(feedback->container());
+        if (auto order = c->arglistOrder())
+            code += bytes(order->container());
+        for (unsigned i = 0; i < c->extraPoolSize; ++i)
+            if (auto prom = Code::check(c->getExtraPoolEntry(i)))
+                addCode(prom);
+    };
+    std::function<void(Function*)> addFunction = [&](Function* f) {
+        functions += bytes(f->container());
+        addCode(f->body());
+        for (size_t i = 0; i < f->nargs(); ++i)
+            if (f->isDefaultArgCompiled(i))
+                addCode(f->defaultArg(i));
+        SEXP splits = f->feedbackSplits();
+        if (splits && splits != R_NilValue) {
+            functions += XLENGTH(splits) * sizeof(SEXP);
+            for (size_t i = 0; i < (size_t)XLENGTH(splits); ++i)
+                if (VECTOR_ELT(splits, i) != R_NilValue)
+                    addFunction(Function::unpack(VECTOR_ELT(splits, i)));
+        }
+    };
+    for (size_t i = 0; i < table->size(); ++i)
+        addFunction(table->get(i));
+}
+
+} // namespace rir
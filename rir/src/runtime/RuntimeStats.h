@@ -0,0 +1,80 @@
+#ifndef RIR_RUNTIME_STATS_H
+#define RIR_RUNTIME_STATS_H
+
+#include "runtime/TypeFeedback.h"
+
+#include <cstddef>
+
+namespace rir {
+
+/*
+ * Process wide counters of the JIT and the interpreter, exposed to R by
+ * rir.runtimeStats. They are plain increments on hot paths, thus always on.
+ * Per closure counters live in the DispatchTable and Code objects.
+ */
+struct RuntimeStats {
+    static constexpr size_t NumDeoptReasons =
+        DeoptReason::DeadBranchReached + 1;
+    static const char* deoptReasonNames[NumDeoptReasons];
+
+    static size_t deopts[NumDeoptReasons];
+    static size_t bindingCacheHits;
+    static size_t bindingCacheMisses;
+    // Lookups past the local frame, remembered across invocations
+    static size_t globalBindingCacheHits;
+    static size_t globalBindingCacheMisses;
+    // Lookups that go through frames which are not locked
+    static size_t globalBindingCacheUncacheable;
+    // Promises of the interpreter reused from the free list
+    static size_t promisesRecycled;
+    // Stores of a for loop index that reused the scalar bound to it
+    static size_t loopVarsUpdatedInPlace;
+    // Only the compilations that installed a version
+    static size_t compilations;
+    static double compileTime;
+    static size_t failedCompilations;
+
+    static size_t codeCacheEvictions;
+    static size_t codeCacheRecompiles;
+    static size_t nativeModulesReleased;
+
+    // Bytes of the deopt metadata, and what it would take without compression
+    // and sharing
+    static size_t deoptMetadataBytes;
+    static size_t deoptMetadataUncompressedBytes;
+
+    // Bytes of the sections currently allocated by the LLVM memory managers
+    static size_t llvmCodeBytes;
+    static size_t llvmDataBytes;
+    static size_t llvmHighWater;
+    static void llvmAllocated(size_t bytes, bool code);
+    static void llvmReleased(size_t code, size_t data);
+
+    static void reset();
+};
+
+struct DispatchTable;
+
+/*
+ * Bytes of the JIT artifacts reachable from one closure, by kind. Shared
+ * objects, e.g. the ASTs in the source and constant pools, are not included.
+ */
+struct ClosureMemory {
+    size_t dispatchTable = 0;
+    // Function objects, including the feedback splits
+    size_t functions = 0;
+    // rir Code objects, including promises and default arguments
+    size_t code = 0;
+    size_t typeFeedback = 0;
+    size_t nativeCode = 0;
+
+    size_t total() const {
+        return dispatchTable + functions + code + typeFeedback + nativeCode;
+    }
+
+    explicit ClosureMemory(DispatchTable* table);
+};
+
+} // namespace rir
+
+#endif
@@ -89,12 +89,35 @@ struct ObservedValues {
 
     std::array<uint8_t, MaxTypes> seen;
 
+    // Shape and value range of the observed vectors. The length is bucketed
+    // by bit width (ie. 0 for empty vectors, 1 for scalars, 2 for length 2-3,
+    // ...). For integers we record the bit width of the largest magnitude.
+    // Only the first MaxScanLength elements are inspected, anything longer is
+    // conservatively assumed to contain NAs and arbitrary integers.
+    static constexpr unsigned MaxScanLength = 16;
+    static constexpr unsigned MaxBits = 31;
+    uint8_t lengthBits : 5;
+    uint8_t maybeNA : 1;
+    uint8_t maybeNegative : 1;
+    uint8_t unused_ : 1;
+    uint8_t intBits : 5;
+    uint8_t unused2_ : 3;
+
+    // Number of times a typecheck speculating on this feedback failed
+    uint8_t numDeopts;
+    uint8_t unused3_;
+
     ObservedValues() {
         // implicitly happens when writing bytecode stream...
         memset(this, 0, sizeof(ObservedValues));
     }
 
-    void reset() { *this = ObservedValues(); }
+    // Failed typechecks are remembered, they are not part of the feedback
+    void reset() {
+        auto deopts = numDeopts;
+        *this = ObservedValues();
+        numDeopts = deopts;
+    }
 
     void print(std::ostream& out) const {
         if (numTypes) {
@@ -104,7 +127,12 @@ struct ObservedValues {
                     out << ", ";
             }
             out << " (" << (object ? "o" : "") << (attribs ? "a" : "")
-                << (notFastVecelt ? "v" : "") << (!notScalar ? "s" : "") << ")";
+                << (notFastVecelt ? "v" : "") << (!notScalar ? "s" : "")
+                << (!maybeNA ? "n" : "") << ")";
+            out << " len<2^" << (unsigned)lengthBits;
+            if (intBits || maybeNegative)
+                out << " int" << (maybeNegative ? "+-" : "+") << "<2^"
+                    << (unsigned)intBits;
             if (stateBeforeLastForce !=
                 ObservedValues::StateBeforeLastForce::unknown) {
                 out << " | "
@@ -120,6 +148,8 @@ struct ObservedValues {
         } else {
             out << "<?>";
         }
+        if (numDeopts)
+            out << " deopts=" << (unsigned)numDeopts;
     };
 
     RIR_INLINE void record(SEXP e) {
@@ -139,6 +169,7 @@ struct ObservedValues {
         notFastVecelt = notFastVecelt || !fastVeceltOk(e);
 
         uint8_t type = TYPEOF(e);
+        recordShape(e, type);
         if (numTypes < MaxTypes) {
             int i = 0;
             for (; i < numTypes; ++i) {
@@ -149,8 +180,61 @@ struct ObservedValues {
                 seen[numTypes++] = type;
         }
     }
+
+  private:
+    static uint8_t bitWidth(R_xlen_t n) {
+        uint8_t bits = 0;
+        while (n && bits < MaxBits) {
+            n >>= 1;
+            bits++;
+        }
+        return bits;
+    }
+
+    RIR_INLINE void recordShape(SEXP e, uint8_t type) {
+        if (type != INTSXP && type != REALSXP && type != LGLSXP) {
+            maybeNA = true;
+            return;
+        }
+        auto len = XLENGTH(e);
+        auto lb = bitWidth(len);
+        if (lengthBits < lb)
+            lengthBits = lb;
+        if (maybeNA && (type != INTSXP || intBits == MaxBits))
+            return;
+
+        if (ALTREP(e) || len > MaxScanLength) {
+            maybeNA = true;
+            if (type == INTSXP) {
+                intBits = MaxBits;
+                maybeNegative = true;
+            }
+            return;
+        }
+        for (R_xlen_t i = 0; i < len; ++i) {
+            if (type == REALSXP) {
+                if (ISNAN(REAL(e)[i]))
+                    maybeNA = true;
+                continue;
+            }
+            int v = INTEGER(e)[i];
+            if (v == NA_INTEGER) {
+                maybeNA = true;
+                continue;
+            }
+            if (type == LGLSXP)
+                continue;
+            if (v < 0) {
+                maybeNegative = true;
+                v = -v;
+            }
+            auto ib = bitWidth(v);
+            if (intBits < ib)
+                intBits = ib;
+        }
+    }
 };
-static_assert(sizeof(ObservedValues) == sizeof(uint32_t),
+static_assert(sizeof(ObservedValues) == 2 * sizeof(uint32_t),
               "Size needs to fit inside a record_ bc immediate args");
 
 enum class Opcode : uint8_t;
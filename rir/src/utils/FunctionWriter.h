@@ -11,6 +11,7 @@
 
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace rir {
@@ -40,6 +41,12 @@ class FunctionWriter {
         defaultArgs.push_back(code->container());
     }
 
+    // The default argument is compiled on first use, see Function::defaultArg
+    void addDeferredDefaultArg(SEXP ast) {
+        preserve(ast);
+        defaultArgs.push_back(ast);
+    }
+
     void finalize(Code* body, const FunctionSignature& signature,
                   const Context& context) {
         assert(function_ == nullptr && "Trying to finalize a second time");
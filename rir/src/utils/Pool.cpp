@@ -3,15 +3,24 @@
 #include "R/Protect.h"
 #include "ir/BC.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace rir {
 
-std::unordered_map<double, unsigned> Pool::numbers;
-std::unordered_map<int, unsigned> Pool::ints;
-std::unordered_map<SEXP, size_t> Pool::contents;
+PoolIndex<uint64_t> Pool::numbers;
+PoolIndex<int> Pool::ints;
+PoolIndex<uintptr_t> Pool::contents;
+std::vector<uint32_t> Pool::refCount;
+std::vector<bool> Pool::pinned;
+std::vector<BC::PoolIdx> Pool::released;
 
 BC::PoolIdx Pool::getNum(double n) {
-    if (numbers.count(n))
-        return numbers.at(n);
+    uint64_t bits;
+    memcpy(&bits, &n, sizeof(double));
+    auto existing = numbers.get(bits);
+    if (!numbers.missing(existing))
+        return existing;
 
     SEXP s = allocVector(REALSXP, 1);
     Protect p(s);
@@ -22,13 +31,15 @@ BC::PoolIdx Pool::getNum(double n) {
     size_t i = cp_pool_add(globalContext(), s);
     assert(i < BC::MAX_POOL_IDX);
 
-    numbers[n] = i;
+    numbers.insert(bits, i);
+    pin(i);
     return i;
 }
 
 BC::PoolIdx Pool::getInt(int n) {
-    if (ints.count(n))
-        return ints.at(n);
+    auto existing = ints.get(n);
+    if (!ints.missing(existing))
+        return existing;
 
     SEXP s = allocVector(INTSXP, 1);
     Protect p(s);
@@ -39,7 +50,43 @@ BC::PoolIdx Pool::getInt(int n) {
     size_t i = cp_pool_add(globalContext(), s);
     assert(i < BC::MAX_POOL_IDX);
 
-    ints[n] = i;
+    ints.insert(n, i);
+    pin(i);
     return i;
 }
+
+void Pool::release(const Refs& refs) {
+    for (auto i : refs) {
+        assert(refCount[i] > 0);
+        if (--refCount[i] == 0)
+            released.push_back(i);
+    }
+}
+
+std::vector<BC::PoolIdx> Pool::reuseReleased() {
+    std::vector<BC::PoolIdx> freed;
+    auto ctx = globalContext();
+    // An entry is released twice if it was referenced again in between
+    std::sort(released.begin(), released.end());
+    released.erase(std::unique(released.begin(), released.end()),
+                   released.end());
+    for (auto i : released) {
+        if (refCount[i] != 0 || (i < pinned.size() && pinned[i]))
+            continue;
+        contents.erase((uintptr_t)cp_pool_at(ctx, i), i);
+        cp_pool_set(ctx, i, R_NilValue);
+        ctx->cpFreeList.push_back(i);
+        freed.push_back(i);
+    }
+    released.clear();
+    return freed;
+}
+
+size_t Pool::memoryUsage() {
+    return globalContext()->cp.capacity * sizeof(SEXP) +
+           numbers.memoryUsage() + ints.memoryUsage() +
+           contents.memoryUsage() + refCount.capacity() * sizeof(uint32_t) +
+           pinned.capacity() / 8 +
+           globalContext()->cpFreeList.capacity() * sizeof(unsigned);
+}
 }
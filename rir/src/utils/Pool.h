@@ -10,44 +10,187 @@
 #include "ir/BC_inc.h"
 #include "R/r.h"
 
-#include <unordered_map>
+#include <cstdint>
+#include <vector>
 
 #include "interpreter/instance.h"
 
 namespace rir {
 
-class Pool {
-    static std::unordered_map<double, BC::PoolIdx> numbers;
-    static std::unordered_map<int, BC::PoolIdx> ints;
-    static std::unordered_map<SEXP, size_t> contents;
+/*
+ * Index from keys to constant pool entries. It uses open addressing with
+ * linear probing in a single array, instead of a node per entry. Erased
+ * entries are filled by shifting the rest of their probe run back, thus there
+ * are no tombstones.
+ */
+template <typename K>
+class PoolIndex {
+    struct Slot {
+        K key;
+        BC::PoolIdx idx;
+    };
+    static constexpr BC::PoolIdx Empty = UINT32_MAX;
+
+    std::vector<Slot> slots;
+    size_t used = 0;
+
+    static size_t hash(K key) {
+        auto h = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 32);
+    }
+
+    Slot& find(K key) {
+        auto mask = slots.size() - 1;
+        for (auto i = hash(key) & mask;; i = (i + 1) & mask) {
+            auto& s = slots[i];
+            if (s.idx == Empty || s.key == key)
+                return s;
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.empty() ? 64 : slots.size() * 2,
+                              Slot{K(), Empty});
+        old.swap(slots);
+        for (auto& s : old)
+            if (s.idx != Empty)
+                find(s.key) = s;
+    }
 
   public:
-    static BC::PoolIdx insert(SEXP e) {
-        if (contents.count(e))
-            return contents.at(e);
+    // Returns Empty if the key is not indexed
+    BC::PoolIdx get(K key) {
+        if (slots.empty())
+            return Empty;
+        return find(key).idx;
+    }
+
+    // Does not overwrite an existing entry
+    void insert(K key, BC::PoolIdx idx) {
+        if ((used + 1) * 4 > slots.size() * 3)
+            grow();
+        auto& s = find(key);
+        if (s.idx == Empty) {
+            s = {key, idx};
+            used++;
+        }
+    }
+
+    // Only removes the entry if it still maps key to idx
+    void erase(K key, BC::PoolIdx idx) {
+        if (slots.empty())
+            return;
+        auto mask = slots.size() - 1;
+        size_t hole = &find(key) - slots.data();
+        if (slots[hole].idx != idx)
+            return;
+        for (auto i = (hole + 1) & mask; slots[i].idx != Empty;
+             i = (i + 1) & mask) {
+            // An entry can fill the hole if it is probed at least as far
+            // from its home slot as the hole is
+            auto home = hash(slots[i].key) & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].idx = Empty;
+        used--;
+    }
+
+    static bool missing(BC::PoolIdx idx) { return idx == Empty; }
+
+    size_t memoryUsage() const { return slots.capacity() * sizeof(Slot); }
+};
+
+class Pool {
+  public:
+    // Pool entries owned by a native module
+    typedef std::vector<BC::PoolIdx> Refs;
+
+  private:
+    // Numbers are keyed by their bit pattern, to keep -0 and NaN payloads
+    static PoolIndex<uint64_t> numbers;
+    static PoolIndex<int> ints;
+    static PoolIndex<uintptr_t> contents;
+
+    // Entries referenced by bytecode or shared metadata live forever, since
+    // nothing tracks their users. Entries inserted on behalf of native code
+    // are counted instead and reused once every module using them is gone.
+    static std::vector<uint32_t> refCount;
+    static std::vector<bool> pinned;
+    static std::vector<BC::PoolIdx> released;
+
+    static BC::PoolIdx add(SEXP e) {
+        auto existing = contents.get((uintptr_t)e);
+        if (!contents.missing(existing))
+            return existing;
 
         SET_NAMED(e, 2);
         size_t i = cp_pool_add(globalContext(), e);
-        contents[e] = i;
+        contents.insert((uintptr_t)e, i);
+        return i;
+    }
+
+    static void pin(BC::PoolIdx i) {
+        if (pinned.size() <= i)
+            pinned.resize(i + 1);
+        pinned[i] = true;
+    }
+
+    static void own(BC::PoolIdx i, Refs& refs) {
+        if (refCount.size() <= i)
+            refCount.resize(i + 1);
+        refCount[i]++;
+        refs.push_back(i);
+    }
+
+  public:
+    static BC::PoolIdx insert(SEXP e) {
+        auto i = add(e);
+        pin(i);
+        return i;
+    }
+
+    static BC::PoolIdx insert(SEXP e, Refs& refs) {
+        auto i = add(e);
+        own(i, refs);
         return i;
     }
 
     static BC::PoolIdx makeSpace() {
         size_t i = cp_pool_add(globalContext(), R_NilValue);
+        pin(i);
+        return i;
+    }
+
+    static BC::PoolIdx makeSpace(Refs& refs) {
+        size_t i = cp_pool_add(globalContext(), R_NilValue);
+        own(i, refs);
         return i;
     }
 
+    // Patched entries are caches, they are not indexed by their contents
     static void patch(BC::PoolIdx idx, SEXP e) {
         SET_NAMED(e, 2);
         cp_pool_set(globalContext(), idx, e);
-        if (!contents.count(e))
-            contents[e] = idx;
     }
 
+    // Drops the references of a collected native module
+    static void release(const Refs& refs);
+    // Frees the released entries which are neither pinned nor referenced
+    // again, cp_pool_add hands them out next. Returns the freed indices in
+    // ascending order.
+    static std::vector<BC::PoolIdx> reuseReleased();
+
     static BC::PoolIdx getNum(double n);
     static BC::PoolIdx getInt(int n);
 
     static SEXP get(BC::PoolIdx i) { return cp_pool_at(globalContext(), i); }
+
+    // Bytes used by the constant pool list and the indices above, excluding
+    // the pooled objects themselves
+    static size_t memoryUsage();
 };
 }
 
@@ -0,0 +1,25 @@
+#ifndef RIR_JSON_H
+#define RIR_JSON_H
+
+#include <ostream>
+
+namespace rir {
+
+// Writes str as a JSON string literal. Quotes and backslashes are escaped,
+// other characters outside of printable ASCII are replaced with '?'.
+inline void writeJsonString(std::ostream& out, const char* str) {
+    out << '"';
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            out << '\\' << *str;
+        else if (*str >= ' ' && *str <= '~')
+            out << *str;
+        else
+            out << '?';
+    }
+    out << '"';
+}
+
+} // namespace rir
+
+#endif
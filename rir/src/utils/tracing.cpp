@@ -0,0 +1,124 @@
+#include "tracing.h"
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+namespace rir {
+
+namespace {
+
+struct TracingImpl {
+    struct Event {
+        double timestamp;
+        const char* category;
+        const char* name;
+        char phase;
+        char detail[47];
+    };
+
+    std::vector<Event> events;
+    std::atomic<size_t> next;
+    std::chrono::time_point<std::chrono::steady_clock> start;
+
+    explicit TracingImpl(size_t size)
+        : events(size), next(0), start(std::chrono::steady_clock::now()) {}
+
+    ~TracingImpl() {
+        if (auto file = getenv("PIR_TRACE"))
+            flush(file);
+    }
+
+    void record(char phase, const char* category, const char* name,
+                const std::string& detail) {
+        auto pos = next.fetch_add(1, std::memory_order_relaxed);
+        auto& e = events[pos % events.size()];
+        std::chrono::duration<double, std::micro> t =
+            std::chrono::steady_clock::now() - start;
+        e.timestamp = t.count();
+        e.category = category;
+        e.name = name;
+        e.phase = phase;
+        auto len = std::min(detail.size(), sizeof(e.detail) - 1);
+        memcpy(e.detail, detail.c_str(), len);
+        e.detail[len] = 0;
+    }
+
+    bool flush(const std::string& file) {
+        std::ofstream out(file);
+        if (!out) {
+            std::cerr << "ERROR: Can't open trace file '" << file << "'\n";
+            return false;
+        }
+
+        auto pid = getpid();
+        size_t last = next.load(std::memory_order_relaxed);
+        size_t first = last > events.size() ? last - events.size() : 0;
+        out << "{\"traceEvents\":[\n";
+        for (size_t i = first; i < last; ++i) {
+            auto& e = events[i % events.size()];
+            if (i != first)
+                out << ",\n";
+            out << "{\"name\":";
+            writeJsonString(out, e.name);
+            out << ",\"cat\":";
+            writeJsonString(out, e.category);
+            out << ",\"ph\":\"" << e.phase << "\",\"ts\":" << std::fixed
+                << e.timestamp << ",\"pid\":" << pid << ",\"tid\":1";
+            if (e.phase == 'i')
+                out << ",\"s\":\"p\"";
+            if (e.detail[0]) {
+                out << ",\"args\":{\"detail\":";
+                writeJsonString(out, e.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return true;
+    }
+};
+
+} // namespace
+
+bool Tracing::enabled = getenv("PIR_TRACE") ? true : false;
+
+static std::unique_ptr<TracingImpl> impl =
+    Tracing::enabled ? std::make_unique<TracingImpl>(
+                           getenv("PIR_TRACE_EVENTS")
+                               ? std::max(1, atoi(getenv("PIR_TRACE_EVENTS")))
+                               : 1 << 16)
+                     : nullptr;
+
+void Tracing::begin(const char* category, const char* name,
+                    const std::string& detail) {
+    if (impl)
+        impl->record('B', category, name, detail);
+}
+
+void Tracing::end(const char* category, const char* name) {
+    if (impl)
+        impl->record('E', category, name, "");
+}
+
+void Tracing::instant(const char* category, const char* name,
+                      const std::string& detail) {
+    if (impl)
+        impl->record('i', category, name, detail);
+}
+
+bool Tracing::flush(const std::string& file) {
+    if (!impl)
+        return false;
+    return impl->flush(file);
+}
+
+} // namespace rir
@@ -0,0 +1,55 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <string>
+
+namespace rir {
+
+/*
+ * Records timestamped JIT events in a fixed size ring buffer. The buffer is
+ * written in the Chrome trace JSON format (chrome://tracing, Perfetto) at exit
+ * or on request, e.g. from R with rir.traceFlush.
+ *
+ * Tracing is enabled by setting PIR_TRACE to the file written at exit.
+ * PIR_TRACE_EVENTS sets the size of the buffer, once it is full the oldest
+ * events are overwritten. Recording an event does not allocate and does not
+ * lock. Event categories and names have to be string literals, additional
+ * information is passed as detail and truncated.
+ */
+class Tracing {
+  public:
+    static bool enabled;
+
+    static void begin(const char* category, const char* name,
+                      const std::string& detail = "");
+    static void end(const char* category, const char* name);
+    static void instant(const char* category, const char* name,
+                        const std::string& detail = "");
+
+    // Writes the events currently in the buffer to file
+    static bool flush(const std::string& file);
+
+    // Records a begin event now and the matching end event when destroyed
+    class Scope {
+      public:
+        Scope(const char* category, const char* name,
+              const std::string& detail = "")
+            : category(category), name(name), active(enabled) {
+            if (active)
+                begin(category, name, detail);
+        }
+        ~Scope() {
+            if (active)
+                end(category, name);
+        }
+
+      private:
+        const char* category;
+        const char* name;
+        bool active;
+    };
+};
+
+} // namespace rir
+
+#endif